@@ -0,0 +1,233 @@
+/**
+ * @file
+ *
+ * Header-only cycle timer shared by the tasks.
+ *
+ * The timestamps are taken with serialized rdtsc/rdtscp instructions, which cost a few dozen cycles instead of
+ * the clock_gettime call behind std::chrono. The C part is usable from plain C, the C++ part adds the TSC
+ * frequency calibration, the subtraction of the timer overhead and per-phase histograms.
+ *
+ */
+
+#pragma once
+
+#ifndef COMMON_CYCLE_TIMER_H_
+#define COMMON_CYCLE_TIMER_H_
+
+#include <stdint.h>
+#include <x86intrin.h>
+
+/**
+  * @brief Timestamp at the start of a measured region.
+  *
+  * The first lfence keeps earlier instructions out of the region, the second one keeps the region from starting
+  * before the timestamp is taken.
+  */
+static inline uint64_t cycle_timer_start(void) {
+    _mm_lfence();
+    const uint64_t tsc = __rdtsc();
+    _mm_lfence();
+    return tsc;
+}
+
+/**
+  * @brief Timestamp at the end of a measured region.
+  *
+  * rdtscp waits until all previous instructions have executed, the lfence keeps later instructions out.
+  */
+static inline uint64_t cycle_timer_stop(void) {
+    unsigned int aux;
+    const uint64_t tsc = __rdtscp(&aux);
+    _mm_lfence();
+    return tsc;
+}
+
+#ifdef __cplusplus
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <string>
+
+/**
+  * @brief Cycles of an empty measured region, i.e., the cost of cycle_timer_start and cycle_timer_stop.
+  *
+  * Minimum over many runs, measured once per process.
+  */
+inline uint64_t cycleTimerOverhead() {
+    static const uint64_t overhead = [] {
+        uint64_t best = UINT64_MAX;
+        for (int i = 0; i < 1000; i++) {
+            const uint64_t start = cycle_timer_start();
+            best = std::min(best, cycle_timer_stop() - start);
+        }
+        return best;
+    }();
+    return overhead;
+}
+
+/**
+  * @brief TSC ticks per nanosecond, calibrated once per process against the steady clock over 10 ms.
+  *
+  * The invariant TSC of current CPUs ticks at a constant rate independent of the core frequency, so TSC cycles
+  * are a wall clock time, not core cycles.
+  */
+inline double tscPerNanosecond() {
+    static const double frequency = [] {
+        const auto begin = std::chrono::steady_clock::now();
+        const uint64_t tsc_begin = cycle_timer_start();
+        std::chrono::steady_clock::time_point end;
+        do {
+            end = std::chrono::steady_clock::now();
+        } while (end - begin < std::chrono::milliseconds(10));
+        const uint64_t tsc_end = cycle_timer_stop();
+        return static_cast<double>(tsc_end - tsc_begin) /
+               std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+    }();
+    return frequency;
+}
+
+/**
+  * @brief Convert TSC cycles to milliseconds
+  */
+inline double cyclesToMilliseconds(uint64_t cycles) {
+    return cycles / tscPerNanosecond() / 1e6;
+}
+
+/**
+  * @brief Class to time executions with the TSC.
+  *
+  * Drop-in replacement of the std::chrono based Timer classes: get() returns milliseconds as well.
+  */
+class CycleTimer {
+public:
+    uint64_t start;
+
+    /**
+      * @brief Take timestamp at a position in the code
+      */
+    CycleTimer() {
+        start = cycle_timer_start();
+    }
+
+    /**
+      * @brief Get TSC cycles from timestamp to now, without the timer overhead
+      */
+    uint64_t cycles() const {
+        const uint64_t elapsed = cycle_timer_stop() - start;
+        const uint64_t overhead = cycleTimerOverhead();
+        return elapsed > overhead ? elapsed - overhead : 0;
+    }
+
+    /**
+      * @brief Get nanoseconds from timestamp to now
+      */
+    double nanoseconds() const {
+        return cycles() / tscPerNanosecond();
+    }
+
+    /**
+      * @brief Get milliseconds from timestamp to now
+      */
+    double get() const {
+        return cyclesToMilliseconds(cycles());
+    }
+};
+
+/**
+  * @brief Distribution of the durations of one phase, e.g., build or probe of one partition.
+  *
+  * Buckets are powers of two of cycles, which is enough to tell a skewed from a uniform distribution and keeps
+  * recording at a few instructions.
+  */
+struct PhaseHistogram {
+    static constexpr int BUCKETS = 64;
+
+    uint64_t count = 0;
+    uint64_t total = 0;
+    uint64_t min = UINT64_MAX;
+    uint64_t max = 0;
+    /// buckets[i] counts durations in [2^(i-1), 2^i), bucket 0 the durations of 0 cycles
+    uint64_t buckets[BUCKETS] = {0};
+
+    /**
+      * @brief Add one duration in cycles
+      */
+    void record(uint64_t cycles) {
+        count++;
+        total += cycles;
+        min = std::min(min, cycles);
+        max = std::max(max, cycles);
+        buckets[cycles == 0 ? 0 : 64 - __builtin_clzll(cycles)]++;
+    }
+
+    /**
+      * @brief Upper bound in cycles of the fraction (0..1] of the durations, with the precision of a bucket
+      */
+    uint64_t percentile(double fraction) const {
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; i++) {
+            seen += buckets[i];
+            if (seen >= fraction * count) {
+                return i == 0 ? 0 : std::min(max, (uint64_t(1) << i) - 1);
+            }
+        }
+        return max;
+    }
+};
+
+/**
+  * @brief Histograms of named phases.
+  */
+class PhaseTimers {
+public:
+    std::map<std::string, PhaseHistogram> phases;
+
+    /**
+      * @brief Record the duration of one execution of a phase
+      */
+    void record(const std::string &phase, uint64_t cycles) {
+        phases[phase].record(cycles);
+    }
+
+    /**
+      * @brief Times a scope and records it for the phase on destruction
+      */
+    class Scope {
+    public:
+        Scope(PhaseTimers &timers, const char *phase) : timers(timers), phase(phase) {}
+        ~Scope() {
+            timers.record(phase, timer.cycles());
+        }
+
+    private:
+        PhaseTimers &timers;
+        const char *phase;
+        CycleTimer timer;
+    };
+
+    /**
+      * @brief Print one line per phase with count, total, mean, min, median, p99 and max in nanoseconds
+      */
+    void print(std::ostream &out) const {
+        const double tsc = tscPerNanosecond();
+        out << std::fixed << std::setprecision(1);
+        for (const auto &entry : phases) {
+            const PhaseHistogram &h = entry.second;
+            out << entry.first << ": count " << h.count << " total " << h.total / tsc << " ns"
+                << " mean " << h.total / tsc / std::max<uint64_t>(h.count, 1) << " min " << h.min / tsc
+                << " p50 <= " << h.percentile(0.5) / tsc << " p99 <= " << h.percentile(0.99) / tsc
+                << " max " << h.max / tsc << std::endl;
+        }
+    }
+
+    void clear() {
+        phases.clear();
+    }
+};
+
+#endif  // __cplusplus
+
+#endif  // COMMON_CYCLE_TIMER_H_
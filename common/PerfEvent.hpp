@@ -0,0 +1,555 @@
+/*
+
+Copyright (c) 2018 Viktor Leis
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+// Shared by the tasks, their PerfEvent.hpp/perfEvent.hpp include this file.
+//
+// Compared to the original perfevent:
+// - The counters of one PMU are opened as a group and read atomically with a single read (PERF_FORMAT_GROUP),
+//   which removes the skew between the counters and most of the instrumentation cost of short regions.
+// - The events are configurable: PerfEvent({"cycles", "dTLB-misses", "r3f24"}) or the PERF_EVENTS environment
+//   variable (comma separated) for the default constructor. Names are the built-in events below, raw events
+//   "r<hex config>" and sysfs events "<pmu>/<event>" (e.g., "uncore_imc_*/cas_count_read", a * in the PMU sums
+//   all matching PMUs). A trailing '?' marks an event as optional, it is dropped if the machine does not have it.
+// - Scope::THREAD counts only the calling thread, for per-thread counters in parallel benchmarks, which are
+//   combined with accumulate().
+
+#pragma once
+
+#if defined(__linux__)
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <asm/unistd.h>
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+struct PerfEvent {
+
+    enum class Scope {
+        PROCESS,  // calling thread and all threads it creates afterwards
+        THREAD    // calling thread only
+    };
+
+    // Hardware events per group, a group with more events than the PMU has counters is never scheduled.
+    // Cycles and instructions usually have fixed counters, software events do not occupy a counter at all.
+    static constexpr unsigned MAX_GROUP_EVENTS = 4;
+
+    struct event {
+        struct read_format {
+            uint64_t value;
+            uint64_t time_enabled;
+            uint64_t time_running;
+        };
+
+        perf_event_attr pe;
+        int fd;
+        bool optional;
+        unsigned counter;  // index in names, several events of a summed sysfs event share one counter
+        int cpu;  // -1 follows the task, uncore events count system-wide on one cpu of their PMU
+        double scale;
+        int groupFd;  // fd of the group leader, -1 for ungrouped events and the leaders themselves
+        read_format prev;
+        read_format data;
+
+        double readCounter() {
+            const uint64_t running = data.time_running - prev.time_running;
+            if (running == 0)
+                return 0;
+            double multiplexingCorrection = static_cast<double>(data.time_enabled - prev.time_enabled) / running;
+            return (data.value - prev.value) * multiplexingCorrection * scale;
+        }
+    };
+
+    std::vector<event> events;
+    std::vector<std::string> names;
+    // counter values of the last measurement, by index in names
+    std::vector<double> values;
+    std::chrono::time_point<std::chrono::steady_clock> startTime;
+    std::chrono::time_point<std::chrono::steady_clock> stopTime;
+    Scope scope;
+
+    static std::vector<std::string> defaultEvents() {
+        const char* env = getenv("PERF_EVENTS");
+        if (env != nullptr && *env != '\0') {
+            std::vector<std::string> list;
+            std::stringstream stream(env);
+            std::string name;
+            while (std::getline(stream, name, ','))
+                if (!name.empty())
+                    list.push_back(name);
+            return list;
+        }
+        // page walks, to separate TLB effects from cache misses, are not available on every machine
+        return {"cycles", "instructions", "L1-misses", "LLC-misses", "branch-misses", "task-clock", "dTLB-misses?"};
+    }
+
+    PerfEvent(const std::vector<std::string>& eventNames = defaultEvents(), Scope scope = Scope::PROCESS) : scope(scope) {
+        for (auto name : eventNames) {
+            bool optional = !name.empty() && name.back() == '?';
+            if (optional)
+                name.pop_back();
+            if (!registerEvent(name, optional) && !optional) {
+                std::cerr << "Error opening counter " << name << std::endl;
+                events.resize(0);
+                names.resize(0);
+                return;
+            }
+        }
+
+        // group reads first, kernels that refuse to inherit groups get one read per counter
+        if (!openEvents(true)) {
+            closeEvents();
+            if (!openEvents(false)) {
+                closeEvents();
+                events.resize(0);
+                names.resize(0);
+                return;
+            }
+        }
+        // optional events that are not available leave unused names behind
+        std::vector<int> index(names.size(), -1);
+        for (auto& event : events)
+            index[event.counter] = 0;
+        std::vector<std::string> used;
+        for (unsigned i=0; i<names.size(); i++) {
+            if (index[i] == 0) {
+                index[i] = used.size();
+                used.push_back(names[i]);
+            }
+        }
+        for (auto& event : events)
+            event.counter = index[event.counter];
+        names = used;
+        values.assign(names.size(), 0);
+    }
+
+    PerfEvent(const PerfEvent&) = delete;
+    PerfEvent& operator=(const PerfEvent&) = delete;
+
+    void registerCounter(const std::string& name, uint64_t type, uint64_t eventID, bool optional=false, int cpu=-1, double scale=1) {
+        if (names.empty() || names.back() != name)
+            names.push_back(name);
+        events.push_back(event());
+        auto& event = events.back();
+        event.optional = optional;
+        event.counter = names.size() - 1;
+        event.cpu = cpu;
+        event.scale = scale;
+        event.fd = -1;
+        event.groupFd = -1;
+        auto& pe = event.pe;
+        memset(&pe, 0, sizeof(struct perf_event_attr));
+        pe.type = type;
+        pe.size = sizeof(struct perf_event_attr);
+        pe.config = eventID;
+        pe.disabled = true;
+        // uncore events count system-wide and can not follow threads
+        pe.inherit = scope == Scope::PROCESS && cpu < 0;
+        pe.inherit_stat = 0;
+        pe.exclude_kernel = false;
+        pe.exclude_hv = false;
+        pe.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    }
+
+    /// Add the events behind a name, false if the name is unknown
+    bool registerEvent(const std::string& name, bool optional) {
+        const uint64_t l1d = PERF_COUNT_HW_CACHE_L1D|(PERF_COUNT_HW_CACHE_OP_READ<<8)|(PERF_COUNT_HW_CACHE_RESULT_MISS<<16);
+        const uint64_t dtlb = PERF_COUNT_HW_CACHE_DTLB|(PERF_COUNT_HW_CACHE_OP_READ<<8)|(PERF_COUNT_HW_CACHE_RESULT_MISS<<16);
+        const std::map<std::string, std::pair<uint64_t, uint64_t>> builtin = {
+            {"cycles", {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES}},
+            {"instructions", {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS}},
+            {"L1-misses", {PERF_TYPE_HW_CACHE, l1d}},
+            {"LLC-misses", {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES}},
+            {"branch-misses", {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}},
+            {"dTLB-misses", {PERF_TYPE_HW_CACHE, dtlb}},
+            {"stalled-cycles-frontend", {PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_FRONTEND}},
+            {"stalled-cycles-backend", {PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND}},
+            {"task-clock", {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK}},
+            {"page-faults", {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS}},
+            {"context-switches", {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES}},
+            {"cpu-migrations", {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS}},
+        };
+        // additional counters can be found in linux/perf_event.h
+        auto it = builtin.find(name);
+        if (it != builtin.end()) {
+            registerCounter(name, it->second.first, it->second.second, optional);
+            return true;
+        }
+        if (name.size() > 1 && name[0] == 'r' && name.find_first_not_of("0123456789abcdefABCDEF", 1) == std::string::npos) {
+            registerCounter(name, PERF_TYPE_RAW, std::stoull(name.substr(1), nullptr, 16), optional);
+            return true;
+        }
+        // memory traffic of the integrated memory controllers, 64 bytes per CAS command
+        if (name == "memory-bytes") {
+            return registerSysfs(name, "uncore_imc_*", "cas_count_read", optional, 64) &&
+                   registerSysfs(name, "uncore_imc_*", "cas_count_write", optional, 64);
+        }
+        const size_t slash = name.find('/');
+        if (slash != std::string::npos)
+            return registerSysfs(name, name.substr(0, slash), name.substr(slash + 1), optional, 0);
+        return false;
+    }
+
+    static std::string readFile(const std::string& path) {
+        std::ifstream file(path);
+        std::string content;
+        std::getline(file, content);
+        return content;
+    }
+
+    /// Event of /sys/bus/event_source/devices/<pmu>/events/<event>, the PMU may end with * to sum all matching
+    /// PMUs. scale 0 takes the scale of sysfs.
+    bool registerSysfs(const std::string& name, const std::string& pmu, const std::string& eventName, bool optional, double scale) {
+        const std::string root = "/sys/bus/event_source/devices/";
+        std::vector<std::string> pmus;
+        if (!pmu.empty() && pmu.back() == '*') {
+            const std::string prefix = pmu.substr(0, pmu.size() - 1);
+            if (DIR* dir = opendir(root.c_str())) {
+                while (dirent* entry = readdir(dir)) {
+                    if (std::string(entry->d_name).compare(0, prefix.size(), prefix) == 0)
+                        pmus.push_back(entry->d_name);
+                }
+                closedir(dir);
+            }
+            std::sort(pmus.begin(), pmus.end());
+        } else {
+            pmus.push_back(pmu);
+        }
+
+        bool found = false;
+        for (auto& device : pmus) {
+            const std::string type = readFile(root + device + "/type");
+            const std::string definition = readFile(root + device + "/events/" + eventName);
+            if (type.empty() || definition.empty())
+                continue;
+            // "event=0x04,umask=0x03", every term is placed into the config bits given by format/<term>
+            uint64_t config = 0;
+            std::stringstream terms(definition);
+            std::string term;
+            while (std::getline(terms, term, ',')) {
+                const size_t equals = term.find('=');
+                const std::string field = term.substr(0, equals);
+                const uint64_t value = equals == std::string::npos ? 1 : std::stoull(term.substr(equals + 1), nullptr, 0);
+                const std::string format = readFile(root + device + "/format/" + field);  // "config:0-7"
+                const size_t colon = format.find(':');
+                if (format.compare(0, colon, "config") != 0)
+                    continue;
+                config |= value << std::stoul(format.substr(colon + 1));
+            }
+            double eventScale = scale;
+            if (eventScale == 0) {
+                const std::string sysfsScale = readFile(root + device + "/events/" + eventName + ".scale");
+                eventScale = sysfsScale.empty() ? 1 : std::stod(sysfsScale);
+            }
+            const std::string cpumask = readFile(root + device + "/cpumask");
+            const int cpu = cpumask.empty() ? -1 : std::stoi(cpumask);
+            registerCounter(name, std::stoull(type), config, optional, cpu, eventScale);
+            found = true;
+        }
+        return found;
+    }
+
+    /// Open all events, grouped per PMU and cpu if grouped is set. Optional events that fail are dropped,
+    /// false if another event fails.
+    bool openEvents(bool grouped) {
+        // members of a group have to be adjacent, so that one read returns their values in order
+        std::stable_sort(events.begin(), events.end(), [](const event& a, const event& b) {
+            return a.cpu != b.cpu ? a.cpu < b.cpu : groupType(a) < groupType(b);
+        });
+        int leaderFd = -1;
+        const event* leader = nullptr;
+        unsigned hardwareEvents = 0;
+        for (unsigned i=0; i<events.size(); i++) {
+            auto& event = events[i];
+            const bool hardware = event.pe.type != PERF_TYPE_SOFTWARE;
+            if (!grouped || leader == nullptr || leader->cpu != event.cpu || groupType(*leader) != groupType(event) ||
+                (hardware && hardwareEvents == MAX_GROUP_EVENTS)) {
+                leaderFd = -1;
+                leader = nullptr;
+                hardwareEvents = 0;
+            }
+            event.pe.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            if (grouped)
+                event.pe.read_format |= PERF_FORMAT_GROUP;
+            // members follow the leader, which enables and disables the whole group
+            event.pe.disabled = leaderFd < 0;
+            event.fd = syscall(__NR_perf_event_open, &event.pe, event.cpu < 0 ? 0 : -1, event.cpu, leaderFd, 0);
+            if (event.fd < 0 && event.optional) {
+                events.erase(events.begin() + i);
+                i--;
+                continue;
+            }
+            if (event.fd < 0) {
+                if (!grouped)
+                    std::cerr << "Error opening counter " << names[event.counter] << std::endl;
+                return false;
+            }
+            event.groupFd = leaderFd;
+            if (leaderFd < 0) {
+                leaderFd = event.fd;
+                leader = &events[i];
+            }
+            hardwareEvents += hardware;
+        }
+        return true;
+    }
+
+    /// Hardware, cache, raw and software events of the core share a group, every other PMU has its own
+    static uint64_t groupType(const event& e) {
+        return e.pe.type <= PERF_TYPE_RAW ? 0 : e.pe.type;
+    }
+
+    void closeEvents() {
+        for (auto& event : events) {
+            if (event.fd >= 0)
+                close(event.fd);
+            event.fd = -1;
+        }
+    }
+
+    /// Read the values of all events, one read for each group
+    void readEvents(bool start) {
+        std::vector<uint64_t> buffer;
+        for (unsigned i=0; i<events.size(); i++) {
+            auto& event = events[i];
+            auto& target = start ? event.prev : event.data;
+            if (!(event.pe.read_format & PERF_FORMAT_GROUP)) {
+                if (read(event.fd, &target, sizeof(uint64_t) * 3) != sizeof(uint64_t) * 3)
+                    std::cerr << "Error reading counter " << names[event.counter] << std::endl;
+                continue;
+            }
+            if (event.groupFd >= 0)
+                continue;  // read with the leader
+            // nr, time_enabled, time_running, value of every member in group order
+            unsigned members = 1;
+            while (i + members < events.size() && events[i + members].groupFd == event.fd)
+                members++;
+            buffer.resize(3 + members);
+            const ssize_t bytes = sizeof(uint64_t) * buffer.size();
+            if (read(event.fd, buffer.data(), bytes) != bytes) {
+                std::cerr << "Error reading counter " << names[event.counter] << std::endl;
+                continue;
+            }
+            for (unsigned m=0; m<members; m++) {
+                auto& member = start ? events[i + m].prev : events[i + m].data;
+                member.value = buffer[3 + m];
+                member.time_enabled = buffer[1];
+                member.time_running = buffer[2];
+            }
+        }
+    }
+
+    void startCounters() {
+        for (auto& event : events) {
+            // a leader resets and enables its whole group
+            if (event.groupFd >= 0)
+                continue;
+            const int flags = (event.pe.read_format & PERF_FORMAT_GROUP) ? PERF_IOC_FLAG_GROUP : 0;
+            ioctl(event.fd, PERF_EVENT_IOC_RESET, flags);
+            ioctl(event.fd, PERF_EVENT_IOC_ENABLE, flags);
+        }
+        readEvents(true);
+        startTime = std::chrono::steady_clock::now();
+    }
+
+    ~PerfEvent() {
+        closeEvents();
+    }
+
+    void stopCounters() {
+        stopTime = std::chrono::steady_clock::now();
+        readEvents(false);
+        for (auto& event : events) {
+            if (event.groupFd >= 0)
+                continue;
+            const int flags = (event.pe.read_format & PERF_FORMAT_GROUP) ? PERF_IOC_FLAG_GROUP : 0;
+            ioctl(event.fd, PERF_EVENT_IOC_DISABLE, flags);
+        }
+        values.assign(names.size(), 0);
+        for (auto& event : events)
+            values[event.counter] += event.readCounter();
+    }
+
+    /// Add the counters of another measurement, e.g., of Scope::THREAD counters of the workers of a parallel
+    /// benchmark. The duration spans both measurements.
+    void accumulate(const PerfEvent& other) {
+        for (unsigned i=0; i<other.names.size(); i++) {
+            auto it = std::find(names.begin(), names.end(), other.names[i]);
+            if (it == names.end())
+                continue;
+            values[it - names.begin()] += other.values[i];
+        }
+        const bool measured = stopTime != std::chrono::time_point<std::chrono::steady_clock>();
+        startTime = measured ? std::min(startTime, other.startTime) : other.startTime;
+        stopTime = measured ? std::max(stopTime, other.stopTime) : other.stopTime;
+    }
+
+    double getDuration() {
+        return std::chrono::duration<double>(stopTime - startTime).count();
+    }
+
+    double getIPC() {
+        return getCounter("instructions") / getCounter("cycles");
+    }
+
+    double getCPUs() {
+        return getCounter("task-clock") / (getDuration() * 1e9);
+    }
+
+    double getGHz() {
+        return getCounter("cycles") / getCounter("task-clock");
+    }
+
+    double getCounter(const std::string& name) {
+        for (unsigned i=0; i<names.size(); i++)
+            if (names[i]==name)
+                return values[i];
+        return -1;
+    }
+
+    static void printCounter(std::ostream& headerOut, std::ostream& dataOut, std::string name, std::string counterValue,bool addComma=true) {
+        auto width=std::max(name.length(),counterValue.length());
+        headerOut << std::setw(width) << name << (addComma ? "," : "") << " ";
+        dataOut << std::setw(width) << counterValue << (addComma ? "," : "") << " ";
+    }
+
+    template <typename T>
+    static void printCounter(std::ostream& headerOut, std::ostream& dataOut, std::string name, T counterValue,bool addComma=true) {
+        std::stringstream stream;
+        stream << std::fixed << std::setprecision(2) << counterValue;
+        PerfEvent::printCounter(headerOut,dataOut,name,stream.str(),addComma);
+    }
+
+    void printReport(std::ostream& out, uint64_t normalizationConstant) {
+        std::stringstream header;
+        std::stringstream data;
+        printReport(header,data,normalizationConstant);
+        out << header.str() << std::endl;
+        out << data.str() << std::endl;
+    }
+
+    void printReport(std::ostream& headerOut, std::ostream& dataOut, uint64_t normalizationConstant) {
+        if (!events.size())
+            return;
+
+        // print all metrics
+        for (unsigned i=0; i<names.size(); i++) {
+            printCounter(headerOut,dataOut,names[i],values[i]/normalizationConstant);
+        }
+
+        printCounter(headerOut,dataOut,"scale",normalizationConstant);
+
+        // derived metrics
+        printCounter(headerOut,dataOut,"IPC",getIPC());
+        printCounter(headerOut,dataOut,"CPUs",getCPUs());
+        printCounter(headerOut,dataOut,"GHz",getGHz(),false);
+    }
+};
+
+struct BenchmarkParameters {
+
+    void setParam(const std::string& name,const std::string& value) {
+        params[name]=value;
+    }
+
+    void setParam(const std::string& name,const char* value) {
+        params[name]=value;
+    }
+
+    template <typename T>
+    void setParam(const std::string& name,T value) {
+        setParam(name,std::to_string(value));
+    }
+
+    void printParams(std::ostream& header,std::ostream& data) {
+        for (auto& p : params) {
+            PerfEvent::printCounter(header,data,p.first,p.second);
+        }
+    }
+
+    BenchmarkParameters(std::string name="") {
+        if (name.length())
+            setParam("name",name);
+    }
+
+private:
+    std::map<std::string,std::string> params;
+};
+
+struct PerfEventBlock {
+    PerfEvent e;
+    uint64_t scale;
+    BenchmarkParameters parameters;
+    bool printHeader;
+
+    PerfEventBlock(uint64_t scale = 1, BenchmarkParameters params = {}, bool printHeader = true)
+            : scale(scale),
+              parameters(params),
+              printHeader(printHeader) {
+        e.startCounters();
+    }
+
+    ~PerfEventBlock() {
+        e.stopCounters();
+        std::stringstream header;
+        std::stringstream data;
+        parameters.printParams(header,data);
+        PerfEvent::printCounter(header,data,"time sec",e.getDuration());
+        e.printReport(header, data, scale);
+        if (printHeader)
+            std::cout << header.str() << std::endl;
+        std::cout << data.str() << std::endl;
+    }
+};
+
+#else
+#include <ostream>
+struct PerfEvent {
+   void startCounters() {}
+   void stopCounters() {}
+   void printReport(std::ostream&, uint64_t) {}
+   template <class T> void setParam(const std::string&, const T&) {};
+};
+
+struct BenchmarkParameters {
+};
+
+struct PerfEventBlock {
+   PerfEventBlock(uint64_t = 1, BenchmarkParameters = {}, bool = true) {};
+   PerfEventBlock(PerfEvent e, uint64_t = 1, BenchmarkParameters = {}, bool = true) {};
+};
+#endif
@@ -1,6 +1,15 @@
 #include "access_patterns.h"
+#include "page_allocation.h"
+#include "thread_utils.h"
+#include "PerfEvent.hpp"
 #include "benchmark/benchmark.h"
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <utility>
+#include <vector>
+
 // ---------------------------------------------------------------------------
 namespace {
 // ---------------------------------------------------------------------------
@@ -82,12 +91,322 @@ void BM_Rev_Sequential(benchmark::State &state) {
   state.counters["Working Set"] = working_set_size;
   state.counters["Stride"] = stride_size;
 }
+
+// Memory-level parallelism: range(1) independent random rings are walked in lockstep by one thread.
+// Throughput grows with the number of chains until the outstanding misses hit the line fill buffer limit.
+void BM_MLP(benchmark::State &state) {
+  const int working_set_size = state.range(0);
+  const int chains = state.range(1);
+  static_assert(sizeof(l) == 8);
+  const int array_size = working_set_size / 8;
+  assert(array_size != 0 && (array_size & (array_size - 1)) == 0);  // check if power of 2, https://stackoverflow.com/a/600306/10971650
+
+  struct l *array = (struct l *)malloc(array_size * sizeof(struct l));
+
+  Init_Random_Chains(array, array_size, chains);
+
+  for (auto _ : state) {
+    Access_Chains(array, array_size, chains);
+  }
+
+  state.SetItemsProcessed(state.iterations() * array_size);
+  state.SetBytesProcessed(state.iterations() * working_set_size);
+
+  state.counters["Working Set"] = working_set_size;
+  state.counters["Chains"] = chains;
+  // every random access loads a whole cache line once the working set exceeds the caches
+  state.counters["Line Bandwidth"] = benchmark::Counter(state.iterations() * array_size * 64.0,
+                                                        benchmark::Counter::kIsRate);
+  free(array);
+}
+
+// L1, LLC and dTLB misses per access, counters that are not available are left out
+void SetMissCounters(benchmark::State &state, PerfEvent &e, double accesses) {
+  for (const char *counter : {"L1-misses", "LLC-misses", "dTLB-misses"}) {
+    const double value = e.getCounter(counter);
+    if (value >= 0) {
+      state.counters[counter] = value / accesses;
+    }
+  }
+}
+
+// Prefetcher control MSR 0x1A4 of Intel cores, a set bit disables a prefetcher: 0 L2 streamer, 1 L2 adjacent line,
+// 2 L1 next line, 3 L1 IP-stride. -1 if the msr module is not loaded or the MSR is not readable.
+int64_t PrefetcherDisableMask() {
+  const int fd = open("/dev/cpu/0/msr", O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+  uint64_t value = 0;
+  const ssize_t bytes = pread(fd, &value, sizeof(value), 0x1A4);
+  close(fd);
+  return bytes == sizeof(value) ? static_cast<int64_t>(value & 0xF) : -1;
+}
+
+// Walk a ring in the benchmark loop and report the latency and the misses per access. The prefetcher mask tells which
+// hardware prefetchers were disabled during the run.
+void MeasureRing(benchmark::State &state, struct l *array, int array_size, ptrdiff_t prefetch_distance) {
+  PerfEvent e;
+  e.startCounters();
+  for (auto _ : state) {
+    if (prefetch_distance == 0) {
+      Access(array, array_size);
+    } else {
+      Access_Prefetch(array, array_size, prefetch_distance);
+    }
+  }
+  e.stopCounters();
+
+  state.SetItemsProcessed(state.iterations() * array_size);
+  state.SetBytesProcessed(state.iterations() * array_size * sizeof(struct l));
+  // seconds per access, the inverse of the items rate
+  state.counters["Latency"] = benchmark::Counter(state.iterations() * array_size,
+                                                 benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+  state.counters["Prefetchers Disabled"] = PrefetcherDisableMask();
+  SetMissCounters(state, e, static_cast<double>(state.iterations()) * array_size);
+}
+
+// Constant stride of range(1) bytes, which may be any multiple of 8, negative strides walk backwards.
+// Strides below the line size are caught by the next line prefetchers, strides up to a few lines by the L2
+// streamer and the IP-stride prefetcher, page-crossing strides (>= 4 KiB) by none of the L2 prefetchers.
+void BM_Stride(benchmark::State &state) {
+  const int working_set_size = state.range(0);
+  const int64_t stride_size = state.range(1);
+  static_assert(sizeof(l) == 8);
+  const int array_size = working_set_size / 8;
+
+  struct l *array = (struct l *)malloc(array_size * sizeof(struct l));
+  Init_Strided(array, array_size, stride_size / static_cast<int64_t>(sizeof(struct l)));
+  MeasureRing(state, array, array_size, 0);
+
+  state.counters["Working Set"] = working_set_size;
+  state.counters["Stride"] = stride_size;
+  free(array);
+}
+
+// range(1) interleaved sequential streams with a stride of one line, the streamer tracks a limited number of
+// streams (e.g., 32 pages on recent Intel cores), beyond that the accesses become misses again
+void BM_Streams(benchmark::State &state) {
+  const int working_set_size = state.range(0);
+  const int streams = state.range(1);
+  static_assert(sizeof(l) == 8);
+  const int array_size = working_set_size / 8;
+
+  struct l *array = (struct l *)malloc(array_size * sizeof(struct l));
+  Init_Streams(array, array_size, streams, 64 / sizeof(struct l));
+  MeasureRing(state, array, array_size, 0);
+
+  state.counters["Working Set"] = working_set_size;
+  state.counters["Streams"] = streams;
+  free(array);
+}
+
+// Tile walk over a matrix of range(0) bytes with rows of 16 KiB, tiles of range(1) x range(2) elements.
+// Each tile row is a short sequential stream, consecutive tile rows are one matrix row apart.
+void BM_Tiles(benchmark::State &state) {
+  const int working_set_size = state.range(0);
+  const int tile_rows = state.range(1);
+  const int tile_cols = state.range(2);
+  static_assert(sizeof(l) == 8);
+  const int array_size = working_set_size / 8;
+  const int cols = (16 << 10) / sizeof(struct l);
+  const int rows = array_size / cols;
+
+  struct l *array = (struct l *)malloc(array_size * sizeof(struct l));
+  Init_Tiles(array, rows, cols, tile_rows, tile_cols);
+  MeasureRing(state, array, array_size, 0);
+
+  state.counters["Working Set"] = working_set_size;
+  state.counters["Tile Rows"] = tile_rows;
+  state.counters["Tile Cols"] = tile_cols;
+  free(array);
+}
+
+// Stride of range(1) bytes with a software prefetch range(2) accesses ahead (0: no prefetch). Software prefetching
+// pays off where the hardware prefetchers give up, e.g., for page-crossing strides, once the distance covers the
+// memory latency. For strides the hardware already catches it only adds instructions.
+void BM_Stride_Prefetch(benchmark::State &state) {
+  const int working_set_size = state.range(0);
+  const int64_t stride_size = state.range(1);
+  const int distance = state.range(2);
+  static_assert(sizeof(l) == 8);
+  const int array_size = working_set_size / 8;
+  const int64_t stride = stride_size / static_cast<int64_t>(sizeof(struct l));
+
+  struct l *array = (struct l *)malloc(array_size * sizeof(struct l));
+  Init_Strided(array, array_size, stride);
+  MeasureRing(state, array, array_size, distance * stride);
+
+  state.counters["Working Set"] = working_set_size;
+  state.counters["Stride"] = stride_size;
+  state.counters["Distance"] = distance;
+  free(array);
+}
+
+// Working sets in L2 and in memory, power-of-two and other strides, forward and backward, within and across pages
+void StrideArguments(benchmark::internal::Benchmark *b) {
+  for (int working_set_size : {1 << 17, 1 << 26}) {
+    for (int64_t stride_size : {8, 24, 64, 72, 128, 192, 320, 512, 1024, 2048, 4096, 4160, 8192, -64, -192, -4096}) {
+      b->Args({working_set_size, stride_size});
+    }
+  }
+}
+
+// Working set in memory, 1 to 64 interleaved streams
+void StreamArguments(benchmark::internal::Benchmark *b) {
+  for (int streams = 1; streams <= 64; streams *= 2) {
+    b->Args({1 << 26, streams});
+  }
+}
+
+// Matrix in memory, sequential, column and square and flat tile walks
+void TileArguments(benchmark::internal::Benchmark *b) {
+  const int rows = (1 << 26) / (16 << 10);
+  for (auto tile : std::vector<std::pair<int, int>>{{1, 2048}, {rows, 1}, {8, 8}, {16, 16}, {64, 64}, {4, 256},
+                                                    {256, 4}}) {
+    b->Args({1 << 26, tile.first, tile.second});
+  }
+}
+
+// Working set in memory, one line, a few lines and page-crossing strides, prefetch distances 0 to 64 accesses
+void PrefetchArguments(benchmark::internal::Benchmark *b) {
+  for (int stride_size : {64, 192, 4096, 4160}) {
+    b->Args({1 << 26, stride_size, 0});
+    for (int distance = 1; distance <= 64; distance *= 2) {
+      b->Args({1 << 26, stride_size, distance});
+    }
+  }
+}
+
+// Random pointer chasing on a working set backed by range(1) (see Page_Backing). With range(2) == 0 the ring is
+// uniformly random, with range(2) == 1 it visits every 4 KiB page once (Init_Random_Pages). Comparing the two and
+// the page sizes separates the page walk costs from the cache misses.
+void BM_Random_Pages(benchmark::State &state) {
+  const int working_set_size = state.range(0);
+  const Page_Backing backing = static_cast<Page_Backing>(state.range(1));
+  const bool page_local = state.range(2) != 0;
+  static_assert(sizeof(l) == 8);
+  const int array_size = working_set_size / 8;
+  assert(array_size != 0 && (array_size & (array_size - 1)) == 0);  // check if power of 2, https://stackoverflow.com/a/600306/10971650
+
+  struct l *array = (struct l *)Allocate_Pages(working_set_size, backing);
+  if (array == nullptr) {
+    state.SkipWithError("pages not available, reserve huge pages first");
+    return;
+  }
+  if (page_local) {
+    Init_Random_Pages(array, array_size, 4096, 1);
+  } else {
+    Init_Random(array, array_size);
+  }
+
+  PerfEvent e;
+  e.startCounters();
+  for (auto _ : state) {
+    Access(array, array_size);
+  }
+  e.stopCounters();
+
+  state.SetItemsProcessed(state.iterations() * array_size);
+  state.SetBytesProcessed(state.iterations() * working_set_size);
+
+  state.counters["Working Set"] = working_set_size;
+  state.counters["Page Size"] = Page_Size(backing);
+  state.counters["Page Local"] = page_local;
+  SetMissCounters(state, e, static_cast<double>(state.iterations()) * array_size);
+  Free_Pages(array, working_set_size, backing);
+}
+
+// Working sets from 4 KiB to 1 GiB for every page backing, uniform and page local rings
+void PageArguments(benchmark::internal::Benchmark *b) {
+  for (int64_t working_set_size = 1 << 12; working_set_size <= 1 << 30; working_set_size <<= 2) {
+    for (int backing = PAGES_REGULAR; backing <= PAGES_HUGETLB_1G; backing++) {
+      b->Args({working_set_size, backing, 0});
+      b->Args({working_set_size, backing, 1});
+    }
+  }
+}
+
+// Working sets from L1 to memory, 1, 2, 4, ... chains each
+void MLPArguments(benchmark::internal::Benchmark *b) {
+  for (int working_set_size = 1 << 14; working_set_size <= 1 << 28; working_set_size <<= 2) {
+    for (int chains = 1; chains <= MAX_CHAINS; chains *= 2) {
+      b->Args({working_set_size, chains});
+    }
+  }
+}
+
+// Random pointer chasing with one pinned thread per cpu, all threads measured at the same time.
+// range(1) == 0: every thread chases a private ring, the rings compete for the LLC and memory channels
+// range(1) == 1: all threads chase the same ring, each starting at a different element
+void BM_Random_Threads(benchmark::State &state) {
+  const int working_set_size = state.range(0);
+  const bool shared = state.range(1) != 0;
+  static_assert(sizeof(l) == 8);
+  const int array_size = working_set_size / 8;
+  assert(array_size != 0 && (array_size & (array_size - 1)) == 0);  // check if power of 2, https://stackoverflow.com/a/600306/10971650
+
+  PinThread(state.thread_index);
+
+  static struct l *shared_array = nullptr;
+  struct l *array = nullptr;
+  if (!shared) {
+    // initialized by the pinned thread, so the ring is allocated on its node
+    array = (struct l *)malloc(array_size * sizeof(struct l));
+    Init_Random(array, array_size);
+  } else if (state.thread_index == 0) {
+    shared_array = (struct l *)malloc(array_size * sizeof(struct l));
+    Init_Random(shared_array, array_size);
+  }
+
+  for (auto _ : state) {
+    if (array == nullptr) {
+      // all threads wait at the start of the loop, thus the shared ring is ready here
+      array = shared_array + static_cast<int64_t>(array_size) * state.thread_index / state.threads;
+    }
+    Access(array, array_size);
+  }
+
+  // items and bytes are summed over the threads, i.e., aggregate throughput and bandwidth
+  state.SetItemsProcessed(state.iterations() * array_size);
+  state.SetBytesProcessed(state.iterations() * working_set_size);
+
+  state.counters["Working Set"] = working_set_size;
+  state.counters["Shared"] = shared;
+  // accesses per second of a single thread, the inverse is the per-thread latency
+  state.counters["Thread Accesses"] = benchmark::Counter(state.iterations() * array_size,
+                                                         benchmark::Counter::kAvgThreadsRate);
+
+  if (!shared) {
+    free(array);
+  } else if (state.thread_index == 0) {
+    // all threads left the loop, none of them reads the shared ring anymore
+    free(shared_array);
+    shared_array = nullptr;
+  }
+}
+
+// 1, 2, 4, ... threads up to the number of cpus
+void ThreadsUpToCpus(benchmark::internal::Benchmark *b) {
+  const int cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  for (int threads = 1; threads < cpus; threads *= 2) {
+    b->Threads(threads);
+  }
+  b->Threads(cpus);
+}
 // ---------------------------------------------------------------------------
 }  // namespace
 // ---------------------------------------------------------------------------
-BENCHMARK(BM_Random)-> Range(1 << 10, 1 << 21);
+BENCHMARK(BM_Random)-> Range(1 << 10, 1 << 28);
 BENCHMARK(BM_Sequential)-> Ranges({{1 << 14, 1 << 21}, {8, 1 << 12}});
 BENCHMARK(BM_Rev_Sequential)-> Ranges({{1 << 14, 1 << 21}, {8, 1 << 12}});
+BENCHMARK(BM_Stride)-> Apply(StrideArguments);
+BENCHMARK(BM_Streams)-> Apply(StreamArguments);
+BENCHMARK(BM_Tiles)-> Apply(TileArguments);
+BENCHMARK(BM_Stride_Prefetch)-> Apply(PrefetchArguments);
+BENCHMARK(BM_Random_Pages)-> Apply(PageArguments);
+BENCHMARK(BM_MLP)-> Apply(MLPArguments);
+BENCHMARK(BM_Random_Threads)-> Ranges({{1 << 10, 1 << 26}, {0, 1}})-> Apply(ThreadsUpToCpus)-> UseRealTime();
 // ---------------------------------------------------------------------------
 int main(int argc, char **argv) {
     benchmark::Initialize(&argc, argv);
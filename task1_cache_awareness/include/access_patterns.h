@@ -1,4 +1,7 @@
 #include <assert.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 #pragma once
@@ -11,60 +14,124 @@ struct l {
   struct l *n;
 };
 
-int ValueInArray(int val, int *array, int array_size) {
-  for(int i = 0; i < array_size; i++) {
-    if(array[i] == val)
-      return 1;
-  }
-  return 0;
+// 64-bit PRNG (splitmix64), fast and without the RAND_MAX limit of rand()
+static inline uint64_t Random64(uint64_t *state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
 }
 
-// Not trivial shuffle, but to generate a single graph containing only one circle
-void Shuffle(int *permuted_index, int array_size) {
-//  int processed_index[array_size - 1];  // without the 0, since 0 is always the last
-  int *processed_index = (int *)malloc((array_size - 1) * sizeof(int));
-
-  int current_index = 0;
-  assert(RAND_MAX > array_size);
-  // (array_size - 1) times exchange
-  for (int i = 0; i < array_size - 1; i++) {
-    int random_number = rand();
-    int next_index = random_number % array_size;
-    while (next_index == 0 || ValueInArray(next_index, processed_index, i) == 1) {
-      next_index = rand() % array_size;
-    }
-    processed_index[i] = next_index;
-    int tmp = permuted_index[next_index];
-    assert(permuted_index[current_index] == 0);
-    permuted_index[next_index] = permuted_index[current_index];
-    permuted_index[current_index] = tmp;
+// Random number in [0, bound), multiply-shift instead of the slow and biased modulo
+static inline uint64_t RandomBelow(uint64_t *state, uint64_t bound) {
+  return (uint64_t)(((unsigned __int128)Random64(state) * bound) >> 64);
+}
+
+#define RANDOM_SEED 42
 
-    current_index = next_index;
+// Sattolo's algorithm: shuffle the next pointers, such that they form a single cycle through all elements.
+// O(n) and no additional memory, every cyclic permutation is equally likely.
+void Init_Random_Seeded(struct l *array, size_t array_size, uint64_t seed) {
+  if (array_size == 0) {
+    return;
+  }
+  for (size_t i = 0; i < array_size; i++) {
+    array[i].n = array + i;
+  }
+  uint64_t state = seed;
+  for (size_t i = array_size - 1; i > 0; i--) {
+    size_t j = RandomBelow(&state, i);  // j < i, thus no element is left on its own
+    struct l *tmp = array[i].n;
+    array[i].n = array[j].n;
+    array[j].n = tmp;
   }
-  free(processed_index);
 }
 
 void Init_Random(struct l *array, int array_size) {
-//  int permuted_index[array_size];
-  int *permuted_index = (int *)malloc(array_size * sizeof(int));
+  Init_Random_Seeded(array, array_size, RANDOM_SEED);
+}
 
-  for (int i = 0; i < array_size; i++) {
-    permuted_index[i] = i;
+struct Random_Pages_Task {
+  struct l *array;
+  size_t array_size;
+  size_t page_elements;
+  const size_t *page_order;
+  size_t begin, end;  // positions in page_order
+  struct l **first, **last;  // per page, entry and exit of the cycle through the page
+  uint64_t seed;
+};
+
+static void *Init_Random_Pages_Worker(void *arg) {
+  struct Random_Pages_Task *task = (struct Random_Pages_Task *)arg;
+  for (size_t pos = task->begin; pos < task->end; pos++) {
+    const size_t page = task->page_order[pos];
+    struct l *begin = task->array + page * task->page_elements;
+    size_t len = task->array_size - page * task->page_elements;
+    len = len < task->page_elements ? len : task->page_elements;
+
+    Init_Random_Seeded(begin, len, task->seed + page);
+    // cut the cycle of the page before its first element
+    struct l *last = begin;
+    while (last->n != begin) {
+      last = last->n;
+    }
+    task->first[page] = begin;
+    task->last[page] = last;
   }
-  Shuffle(permuted_index, array_size);
+  return NULL;
+}
 
-  int next_offset = permuted_index[0];
-  struct l *current = array;
-  for (int i = 0; i < array_size; i++) {
-    current->n = array + next_offset;
-    current = array + next_offset;
-    if (i == array_size) {
-      assert(next_offset == 0);
-      break;
+// Page aware random ring: the pages are visited in random order and all elements of a page in random order
+// before moving on to the next page, i.e., one TLB miss per page. page_size is in bytes. The pages are
+// shuffled by threads threads in parallel, so large working sets are initialized in a fraction of the time.
+void Init_Random_Pages(struct l *array, size_t array_size, size_t page_size, int threads) {
+  const size_t page_elements = page_size / sizeof(struct l);
+  const size_t pages = (array_size + page_elements - 1) / page_elements;
+  if (pages == 0) {
+    return;
+  }
+  size_t *page_order = (size_t *)malloc(pages * sizeof(size_t));
+  struct l **first = (struct l **)malloc(pages * sizeof(struct l *));
+  struct l **last = (struct l **)malloc(pages * sizeof(struct l *));
+
+  // Fisher-Yates, the ring closes at the end of the order anyway
+  uint64_t state = RANDOM_SEED;
+  for (size_t i = 0; i < pages; i++) {
+    page_order[i] = i;
+  }
+  for (size_t i = pages - 1; i > 0; i--) {
+    size_t j = RandomBelow(&state, i + 1);
+    size_t tmp = page_order[i];
+    page_order[i] = page_order[j];
+    page_order[j] = tmp;
+  }
+
+  threads = threads < 1 ? 1 : threads;
+  threads = (size_t)threads > pages ? (int)pages : threads;
+  pthread_t *workers = (pthread_t *)malloc(threads * sizeof(pthread_t));
+  struct Random_Pages_Task *tasks = (struct Random_Pages_Task *)malloc(threads * sizeof(struct Random_Pages_Task));
+  for (int t = 0; t < threads; t++) {
+    struct Random_Pages_Task task = {array, array_size, page_elements, page_order,
+                                     pages * t / threads, pages * (t + 1) / threads, first, last, RANDOM_SEED};
+    tasks[t] = task;
+    if (t > 0) {
+      pthread_create(&workers[t], NULL, Init_Random_Pages_Worker, &tasks[t]);
     }
-    next_offset = permuted_index[next_offset];
   }
-  free(permuted_index);
+  Init_Random_Pages_Worker(&tasks[0]);
+  for (int t = 1; t < threads; t++) {
+    pthread_join(workers[t], NULL);
+  }
+
+  // chain the pages in their random order
+  for (size_t i = 0; i < pages; i++) {
+    last[page_order[i]]->n = first[page_order[(i + 1) % pages]];
+  }
+  free(tasks);
+  free(workers);
+  free(last);
+  free(first);
+  free(page_order);
 }
 
 void Init_Sequential(struct l *array, int inner_iter, int outer_iter, int stride_offset) {
@@ -97,6 +164,117 @@ void Access(struct l *array, int array_size) {
   }
   assert(ele == array);
 }
+
+// Ring with a constant stride of stride elements, which does not have to be a power of two. The walk visits
+// offset 0, stride, 2 * stride, ... up to the end of the array, then the same from offset 1, and so on, so every
+// element is visited once. A negative stride walks the array backwards, starting at its last element.
+void Init_Strided(struct l *array, size_t array_size, ptrdiff_t stride) {
+  assert(stride != 0 && array_size > 0);
+  const size_t step = stride > 0 ? (size_t)stride : (size_t)-stride;
+  struct l *prev = NULL;
+  for (size_t offset = 0; offset < step && offset < array_size; offset++) {
+    for (size_t i = offset; i < array_size; i += step) {
+      struct l *ele = stride > 0 ? array + i : array + array_size - 1 - i;
+      if (prev != NULL) {
+        prev->n = ele;
+      }
+      prev = ele;
+    }
+  }
+  prev->n = stride > 0 ? array : array + array_size - 1;
+}
+
+// Interleaved streams: the array is split into streams regions, which are walked with a stride of stride elements
+// in round robin, i.e., one access per stream and step. array_size has to be a multiple of streams.
+void Init_Streams(struct l *array, size_t array_size, size_t streams, size_t stride) {
+  assert(streams >= 1 && stride >= 1 && array_size % streams == 0);
+  const size_t region = array_size / streams;
+  struct l *prev = NULL;
+  for (size_t offset = 0; offset < stride && offset < region; offset++) {
+    for (size_t i = offset; i < region; i += stride) {
+      for (size_t s = 0; s < streams; s++) {
+        struct l *ele = array + s * region + i;
+        if (prev != NULL) {
+          prev->n = ele;
+        }
+        prev = ele;
+      }
+    }
+  }
+  prev->n = array;
+}
+
+// 2D tile walk over a row-major matrix of rows x cols elements: the tiles of tile_rows x tile_cols elements are
+// visited in row-major order, and the elements within a tile, too. Tiles of (1, cols) are a plain sequential walk,
+// (rows, 1) walks the columns, i.e., a stride of one row.
+void Init_Tiles(struct l *array, size_t rows, size_t cols, size_t tile_rows, size_t tile_cols) {
+  assert(tile_rows >= 1 && tile_cols >= 1 && rows % tile_rows == 0 && cols % tile_cols == 0);
+  struct l *prev = NULL;
+  for (size_t tile_row = 0; tile_row < rows; tile_row += tile_rows) {
+    for (size_t tile_col = 0; tile_col < cols; tile_col += tile_cols) {
+      for (size_t row = tile_row; row < tile_row + tile_rows; row++) {
+        for (size_t col = tile_col; col < tile_col + tile_cols; col++) {
+          struct l *ele = array + row * cols + col;
+          if (prev != NULL) {
+            prev->n = ele;
+          }
+          prev = ele;
+        }
+      }
+    }
+  }
+  prev->n = array;
+}
+
+// Access with software prefetching: while following the ring, the element distance elements after the current
+// one is prefetched, as long as it lies within the array. For a ring of constant stride, distance = k * stride
+// prefetches the element k accesses ahead.
+void Access_Prefetch(struct l *array, int array_size, ptrdiff_t distance) {
+  const uintptr_t begin = (uintptr_t)array;
+  const uintptr_t end = (uintptr_t)(array + array_size);
+  struct l *ele = array;
+  for (int i = 0; i < array_size; i++) {
+    const uintptr_t ahead = (uintptr_t)ele + distance * (ptrdiff_t)sizeof(struct l);
+    if (ahead >= begin && ahead < end) {
+      __builtin_prefetch((const void *)ahead, 0, 3);
+    }
+    __asm__ volatile("" : "+g" (*ele) : :);
+    ele = ele->n;
+  }
+  assert(ele == array);
+}
+
+#define MAX_CHAINS 32
+
+// Split the array into chains disjoint random rings of array_size / chains elements each
+void Init_Random_Chains(struct l *array, int array_size, int chains) {
+  assert(chains >= 1 && chains <= MAX_CHAINS && array_size >= chains);
+  const int chain_size = array_size / chains;
+  for (int c = 0; c < chains; c++) {
+    Init_Random(array + c * chain_size, chain_size);
+  }
+}
+
+// Follow all rings of Init_Random_Chains in lockstep. Each ring is a dependent chain, but the loads of
+// different rings are independent, so up to chains misses can be outstanding at the same time.
+// The current elements are kept in a small array, which stays in L1.
+void Access_Chains(struct l *array, int array_size, int chains) {
+  assert(chains >= 1 && chains <= MAX_CHAINS);
+  const int chain_size = array_size / chains;
+  struct l *ele[MAX_CHAINS];
+  for (int c = 0; c < chains; c++) {
+    ele[c] = array + c * chain_size;
+  }
+  for (int i = 0; i < chain_size; i++) {
+    for (int c = 0; c < chains; c++) {
+      __asm__ volatile("" : "+g" (*ele[c]) : :);
+      ele[c] = ele[c]->n;
+    }
+  }
+  for (int c = 0; c < chains; c++) {
+    assert(ele[c] == array + c * chain_size);
+  }
+}
 // ---------------------------------------------------------------------------------------------------
 #endif  // INCLUDE_ACCESS_PATTERNS_H_
 // ---------------------------------------------------------------------------------------------------
@@ -0,0 +1,93 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <linux/mman.h>
+
+#pragma once
+
+#ifndef INCLUDE_PAGE_ALLOCATION_H_
+#define INCLUDE_PAGE_ALLOCATION_H_
+// ---------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------
+// Pages backing a working set
+enum Page_Backing {
+  PAGES_REGULAR = 0,     // 4 KiB pages, transparent huge pages disabled for the mapping
+  PAGES_THP = 1,         // 2 MiB aligned mapping with madvise(MADV_HUGEPAGE)
+  PAGES_HUGETLB_2M = 2,  // explicit 2 MiB pages, have to be reserved in /proc/sys/vm/nr_hugepages
+  PAGES_HUGETLB_1G = 3   // explicit 1 GiB pages, have to be reserved at boot or via sysfs
+};
+
+#define HUGE_PAGE_2M ((size_t)1 << 21)
+#define HUGE_PAGE_1G ((size_t)1 << 30)
+
+const char *Page_Backing_Name(enum Page_Backing backing) {
+  switch (backing) {
+    case PAGES_REGULAR: return "4K";
+    case PAGES_THP: return "THP";
+    case PAGES_HUGETLB_2M: return "2M";
+    case PAGES_HUGETLB_1G: return "1G";
+  }
+  return "unknown";
+}
+
+size_t Page_Size(enum Page_Backing backing) {
+  switch (backing) {
+    case PAGES_HUGETLB_1G: return HUGE_PAGE_1G;
+    case PAGES_THP:
+    case PAGES_HUGETLB_2M: return HUGE_PAGE_2M;
+    default: return 4096;
+  }
+}
+
+// Size of the mapping for size bytes, whole pages of the backing
+size_t Mapping_Size(size_t size, enum Page_Backing backing) {
+  const size_t page_size = Page_Size(backing);
+  return (size + page_size - 1) / page_size * page_size;
+}
+
+// Allocate size bytes backed by the given pages, NULL if the pages are not available.
+// The memory has to be released with Free_Pages.
+void *Allocate_Pages(size_t size, enum Page_Backing backing) {
+  const size_t mapping_size = Mapping_Size(size, backing);
+  const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  void *ptr = MAP_FAILED;
+  switch (backing) {
+    case PAGES_REGULAR:
+      ptr = mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, flags, -1, 0);
+      if (ptr != MAP_FAILED) {
+        madvise(ptr, mapping_size, MADV_NOHUGEPAGE);
+      }
+      break;
+    case PAGES_THP: {
+      // over-allocate to cut out a 2 MiB aligned range, which the kernel can back with huge pages
+      char *raw = (char *)mmap(NULL, mapping_size + HUGE_PAGE_2M, PROT_READ | PROT_WRITE, flags, -1, 0);
+      if (raw == MAP_FAILED) {
+        break;
+      }
+      char *aligned = (char *)(((uintptr_t)raw + HUGE_PAGE_2M - 1) & ~(HUGE_PAGE_2M - 1));
+      if (aligned > raw) {
+        munmap(raw, aligned - raw);
+      }
+      munmap(aligned + mapping_size, raw + HUGE_PAGE_2M - aligned);
+      madvise(aligned, mapping_size, MADV_HUGEPAGE);
+      ptr = aligned;
+      break;
+    }
+    case PAGES_HUGETLB_2M:
+      ptr = mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB | MAP_HUGE_2MB, -1, 0);
+      break;
+    case PAGES_HUGETLB_1G:
+      ptr = mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB | MAP_HUGE_1GB, -1, 0);
+      break;
+  }
+  return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+void Free_Pages(void *ptr, size_t size, enum Page_Backing backing) {
+  if (ptr != NULL) {
+    munmap(ptr, Mapping_Size(size, backing));
+  }
+}
+// ---------------------------------------------------------------------------------------------------
+#endif  // INCLUDE_PAGE_ALLOCATION_H_
+// ---------------------------------------------------------------------------------------------------
@@ -0,0 +1,46 @@
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <atomic>
+
+#pragma once
+
+#ifndef INCLUDE_THREAD_UTILS_H_
+#define INCLUDE_THREAD_UTILS_H_
+// ---------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------
+// Pin the calling thread to one cpu, threads beyond the number of cpus wrap around
+inline bool PinThread(int thread_index) {
+  const int cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(thread_index % cpus, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+// Reusable barrier, spinning threads do not depend on the scheduler to start the measured region together
+class SpinBarrier {
+ public:
+  explicit SpinBarrier(int threads) : threads_(threads), waiting_(0), round_(0) {}
+
+  void Wait() {
+    const int round = round_.load();
+    if (waiting_.fetch_add(1) + 1 == threads_) {
+      waiting_.store(0);
+      round_.fetch_add(1);
+      return;
+    }
+    while (round_.load() == round) {
+      sched_yield();
+    }
+  }
+
+ private:
+  const int threads_;
+  std::atomic<int> waiting_;
+  std::atomic<int> round_;
+};
+// ---------------------------------------------------------------------------------------------------
+#endif  // INCLUDE_THREAD_UTILS_H_
+// ---------------------------------------------------------------------------------------------------
@@ -0,0 +1,333 @@
+#include "access_patterns.h"
+#include "../../common/CycleTimer.h"
+#include "page_allocation.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// ---------------------------------------------------------------------------------------------------
+namespace {
+// ---------------------------------------------------------------------------------------------------
+constexpr int RUNS = 5;
+// accesses per measurement, enough to hide the timer overhead and the cold misses of small rings
+constexpr uint64_t MIN_ACCESSES = 1 << 20;
+// relative latency increase that counts as leaving a plateau, i.e., a level of the hierarchy
+constexpr double JUMP = 1.3;
+// adjacent plateaus whose latencies differ by less than this factor are one level, e.g., a latency that rises
+// gradually within a cache on a noisy machine or a VM
+constexpr double MERGE = 1.5;
+
+struct Point {
+  size_t x;  // working set bytes, stride or number of elements
+  double cycles;  // per access
+};
+
+struct Level {
+  size_t size;  // last x on the plateau
+  double cycles;  // latency on the plateau
+};
+
+// Follow a ring for steps accesses. Unlike Access, the element is only kept in a register, since writing it back
+// adds store forwarding (and 4K aliasing) to the measured latency.
+struct l *Chase(struct l *ele, uint64_t steps) {
+  for (uint64_t i = 0; i < steps; i++) {
+    __asm__ volatile("" : "+r" (ele) : :);
+    ele = ele->n;
+  }
+  return ele;
+}
+
+// Median cycles per access of walking the ring containing start, the ring has elements elements
+double Measure(struct l *start, size_t elements) {
+  const uint64_t steps = std::max<uint64_t>(MIN_ACCESSES, elements);
+  Chase(start, elements);  // warm up
+  uint64_t cycles_runs[RUNS];
+  for (int i = 0; i < RUNS; i++) {
+    const uint64_t begin = cycle_timer_start();
+    start = Chase(start, steps);
+    cycles_runs[i] = cycle_timer_stop() - begin;
+  }
+  std::sort(cycles_runs, cycles_runs + RUNS);
+  return static_cast<double>(cycles_runs[RUNS / 2]) / steps;
+}
+
+// Link the elements at offsets (in elements) into a ring in the given order
+void Link(struct l *array, const std::vector<size_t> &offsets) {
+  for (size_t i = 0; i < offsets.size(); i++) {
+    array[offsets[i]].n = array + offsets[(i + 1) % offsets.size()];
+  }
+}
+
+// Random order of 0, ..., n - 1
+std::vector<size_t> RandomOrder(size_t n, uint64_t seed) {
+  std::vector<size_t> order(n);
+  for (size_t i = 0; i < n; i++) {
+    order[i] = i;
+  }
+  for (size_t i = n - 1; i > 0 && n > 0; i--) {
+    std::swap(order[i], order[RandomBelow(&seed, i + 1)]);
+  }
+  return order;
+}
+
+void PrintCurve(const char *header, const std::vector<Point> &curve) {
+  std::cerr << header << std::endl;
+  for (const auto &point : curve) {
+    std::cerr << point.x << ", " << point.cycles << std::endl;
+  }
+}
+
+// Latency never drops for a larger working set, so the curve is replaced by the minimum of all larger points.
+// This removes outliers caused by interrupts or frequency changes.
+std::vector<Point> Monotone(std::vector<Point> curve) {
+  for (size_t i = curve.size(); i-- > 1;) {
+    curve[i - 1].cycles = std::min(curve[i - 1].cycles, curve[i].cycles);
+  }
+  return curve;
+}
+
+// Split a latency curve into plateaus. A plateau ends at the last point below JUMP times its latency, the next
+// one starts once the latency stops rising by more than 10% per point. Adjacent plateaus within MERGE of each other
+// are merged, the latency of a level is the median of all its points. A plateau that spans less than a power of two
+// of x lies within a gradual transition and is dropped, unless it is the last one.
+std::vector<Level> Plateaus(const std::vector<Point> &curve) {
+  std::vector<std::vector<double>> plateaus;
+  std::vector<Level> levels;
+  size_t i = 0;
+  while (i < curve.size()) {
+    const double base = curve[i].cycles;
+    std::vector<double> plateau{base};
+    while (i + 1 < curve.size() && curve[i + 1].cycles < base * JUMP) {
+      plateau.push_back(curve[++i].cycles);
+    }
+    std::sort(plateau.begin(), plateau.end());
+    const double cycles = plateau[plateau.size() / 2];
+    const bool transition = i + 1 < curve.size() && curve[i].x < curve[i + 1 - plateau.size()].x * 2;
+    if (!transition && !levels.empty() && cycles < levels.back().cycles * MERGE) {
+      plateaus.back().insert(plateaus.back().end(), plateau.begin(), plateau.end());
+      std::sort(plateaus.back().begin(), plateaus.back().end());
+      levels.back() = Level{curve[i].x, plateaus.back()[plateaus.back().size() / 2]};
+    } else if (!transition) {
+      plateaus.push_back(plateau);
+      levels.push_back(Level{curve[i].x, cycles});
+    }
+    // skip the transition to the next level
+    i++;
+    while (i + 1 < curve.size() && curve[i + 1].cycles > curve[i].cycles * 1.1) {
+      i++;
+    }
+  }
+  return levels;
+}
+
+// Smallest power of two of at least size. Addresses a multiple of the way size (sets * line size, a power of two)
+// apart map to the same set, but the plateau ends of the latency curve are not powers of two.
+size_t PowerOfTwoAtLeast(size_t size) {
+  size_t power = 1;
+  while (power < size) {
+    power *= 2;
+  }
+  return power;
+}
+
+// Latency of random accesses for working sets from 1 KiB to max_size, four sizes per power of two.
+// Transparent huge pages keep page walks out of the cache levels.
+std::vector<Point> LatencyCurve(size_t max_size) {
+  std::vector<Point> curve;
+  struct l *array = (struct l *)Allocate_Pages(max_size, PAGES_THP);
+  if (array == nullptr) {
+    std::cerr << Page_Backing_Name(PAGES_THP) << " pages not available, no latency curve" << std::endl;
+    return curve;
+  }
+  for (size_t base = 1 << 10; base <= max_size; base *= 2) {
+    for (double factor : {1.0, 1.19, 1.41, 1.68}) {
+      const size_t size = static_cast<size_t>(base * factor) / 64 * 64;
+      if (size > max_size) {
+        break;
+      }
+      Init_Random_Seeded(array, size / sizeof(struct l), RANDOM_SEED);
+      curve.push_back(Point{size, Measure(array, size / sizeof(struct l))});
+    }
+  }
+  Free_Pages(array, max_size, PAGES_THP);
+  return curve;
+}
+
+// Pairs of accesses distance bytes apart in random pages of a working set beyond the caches. Both accesses hit the
+// same line as long as distance is below the line size, afterwards both miss.
+size_t LineSize(size_t working_set) {
+  std::vector<Point> curve;
+  const size_t page_elements = 4096 / sizeof(struct l);
+  const size_t pages = working_set / 4096;
+  struct l *array = (struct l *)Allocate_Pages(working_set, PAGES_REGULAR);
+  if (array == nullptr) {
+    std::cerr << Page_Backing_Name(PAGES_REGULAR) << " pages not available, no line size" << std::endl;
+    return 0;
+  }
+  const std::vector<size_t> order = RandomOrder(pages, RANDOM_SEED);
+  for (size_t distance = 8; distance <= 2048; distance *= 2) {
+    std::vector<size_t> offsets;
+    for (size_t page : order) {
+      offsets.push_back(page * page_elements);
+      offsets.push_back(page * page_elements + distance / sizeof(struct l));
+    }
+    Link(array, offsets);
+    curve.push_back(Point{distance, Measure(array, offsets.size())});
+  }
+  Free_Pages(array, working_set, PAGES_REGULAR);
+
+  const double low = curve.front().cycles;
+  const double high = curve.back().cycles;
+  for (const auto &point : curve) {
+    if (point.cycles >= low + (high - low) / 2) {
+      return point.x;
+    }
+  }
+  return 0;
+}
+
+// Rings of k elements, which are stride bytes apart and thus map to the same set of every cache whose way size
+// (sets * line size) divides stride. Once k exceeds the associativity of a level, every access misses it, so the
+// associativity is the largest k whose latency stays below limit, a latency between the level and the next one.
+size_t Associativity(size_t stride, double limit) {
+  const size_t max_ways = 32;
+  const size_t bytes = stride * (max_ways + 1);
+  struct l *array = (struct l *)Allocate_Pages(bytes, PAGES_THP);
+  if (array == nullptr) {
+    std::cerr << Page_Backing_Name(PAGES_THP) << " pages not available, no associativity" << std::endl;
+    return 0;
+  }
+  std::vector<Point> curve;
+  for (size_t k = 1; k <= max_ways + 1; k++) {
+    std::vector<size_t> offsets;
+    for (size_t i = 0; i < k; i++) {
+      offsets.push_back(i * stride / sizeof(struct l));
+    }
+    Link(array, offsets);
+    curve.push_back(Point{k, Measure(array, k)});
+  }
+  Free_Pages(array, bytes, PAGES_THP);
+
+  PrintCurve(("ways(stride " + std::to_string(stride) + "),cycles").c_str(), curve);
+
+  // 0 if the rings never leave the level or never fit into it
+  curve = Monotone(curve);
+  for (size_t i = 1; i < curve.size(); i++) {
+    if (curve[i].cycles > limit) {
+      return curve[0].cycles <= limit ? curve[i - 1].x : 0;
+    }
+  }
+  return 0;
+}
+
+// One access per 4 KiB page in random page order. Each page uses a different cache line, so the lines stay cached
+// and the latency only rises once the pages exceed the reach of a TLB level.
+std::vector<Point> TLBCurve(size_t max_pages) {
+  std::vector<Point> curve;
+  const size_t page_elements = 4096 / sizeof(struct l);
+  struct l *array = (struct l *)Allocate_Pages(max_pages * 4096, PAGES_REGULAR);
+  if (array == nullptr) {
+    std::cerr << Page_Backing_Name(PAGES_REGULAR) << " pages not available, no TLB curve" << std::endl;
+    return curve;
+  }
+  for (size_t base = 8; base <= max_pages; base *= 2) {
+    for (double factor : {1.0, 1.19, 1.41, 1.68}) {
+      const size_t pages = static_cast<size_t>(base * factor);
+      if (pages > max_pages) {
+        break;
+      }
+      std::vector<size_t> offsets;
+      for (size_t page : RandomOrder(pages, RANDOM_SEED)) {
+        offsets.push_back(page * page_elements + (page * 64 % 4096) / sizeof(struct l));
+      }
+      Link(array, offsets);
+      curve.push_back(Point{pages, Measure(array, pages)});
+    }
+  }
+  Free_Pages(array, max_pages * 4096, PAGES_REGULAR);
+  return curve;
+}
+
+// ---------------------------------------------------------------------------------------------------
+}  // namespace
+// ---------------------------------------------------------------------------------------------------
+// Usage: cachecalibrate [max working set exponent] [profile file]
+// Measures the cache hierarchy with the random pointer chasing kernels and writes a key=value hardware profile to the
+// profile file (default stdout). The measured curves are printed to stderr. Latencies are in TSC cycles per access.
+int main(int argc, char *argv[]) {
+  const int max_exponent = argc > 1 ? atoi(argv[1]) : 28;
+  if (max_exponent < 16 || max_exponent > 32) {
+    return 1;
+  }
+  const size_t max_size = static_cast<size_t>(1) << max_exponent;
+
+  const std::vector<Point> latency = LatencyCurve(max_size);
+  PrintCurve("workingset(Bytes),cycles", latency);
+  std::vector<Level> levels = Plateaus(Monotone(latency));
+  // the last plateau is main memory, unless the sweep ended within a cache
+  const bool memory_reached = levels.size() > 1;
+  const Level memory = memory_reached ? levels.back() : Level{0, 0};
+  if (memory_reached) {
+    levels.pop_back();
+  }
+
+  const size_t line_size = LineSize(std::min<size_t>(max_size, 64 << 20));
+
+  std::vector<size_t> ways;
+  for (size_t i = 0; i < levels.size() && i < 2; i++) {
+    // The set index of the private caches lies within a huge page, shared caches hash the sets across slices.
+    // Power-of-two strides from a quarter of the level size up are multiples of the way size of a cache with at least
+    // 4 ways. Some L1 caches show fewer ways at large strides, e.g., with tags of hashed upper address bits, so the
+    // largest associativity of these strides is taken.
+    // the next level of the hierarchy is at least twice as slow
+    const double limit = 2 * levels[i].cycles;
+    const size_t stride = PowerOfTwoAtLeast(levels[i].size);
+    size_t level_ways = 0;
+    for (size_t divisor = 1; divisor <= 4; divisor *= 2) {
+      level_ways = std::max(level_ways, Associativity(stride / divisor, limit));
+    }
+    ways.push_back(level_ways);
+  }
+
+  const std::vector<Point> tlb = TLBCurve(std::min<size_t>(max_size / 4096, 1 << 15));
+  PrintCurve("pages,cycles", tlb);
+  std::vector<Level> tlb_levels = Plateaus(Monotone(tlb));
+  if (!tlb_levels.empty()) {
+    tlb_levels.pop_back();  // page walks
+  }
+
+  std::ofstream file;
+  if (argc > 2) {
+    file.open(argv[2]);
+  }
+  std::ostream &out = argc > 2 ? file : std::cout;
+  out << "# hardware profile of cachecalibrate, sizes in bytes and latencies in cycles per access" << std::endl;
+  if (line_size > 0) {
+    out << "line_size=" << line_size << std::endl;
+  }
+  out << "cache_levels=" << levels.size() << std::endl;
+  for (size_t i = 0; i < levels.size(); i++) {
+    out << "l" << i + 1 << "_size=" << levels[i].size << std::endl;
+    out << "l" << i + 1 << "_latency=" << levels[i].cycles << std::endl;
+    if (i < ways.size() && ways[i] > 0) {
+      out << "l" << i + 1 << "_associativity=" << ways[i] << std::endl;
+    }
+  }
+  if (memory_reached) {
+    out << "memory_latency=" << memory.cycles << std::endl;
+  }
+  out << "tlb_levels=" << tlb_levels.size() << std::endl;
+  for (size_t i = 0; i < tlb_levels.size(); i++) {
+    out << "tlb" << i + 1 << "_entries=" << tlb_levels[i].size << std::endl;
+    out << "tlb" << i + 1 << "_reach=" << tlb_levels[i].size * 4096 << std::endl;
+    out << "tlb" << i + 1 << "_latency=" << tlb_levels[i].cycles << std::endl;
+  }
+  return 0;
+}
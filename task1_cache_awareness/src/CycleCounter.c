@@ -1,19 +1,10 @@
 #include "access_patterns.h"
+#include "../../common/CycleTimer.h"
 
 #include <stdint.h>
 #include <string.h>
 #include <stdio.h>
 
-static inline void
-getcyclecount(uint64_t* cycles) {
-  __asm volatile(
-  "cpuid # force all prev. instr. to complete\n\t"
-  "rdtsc # TSC → edx:eax \n\t"
-  "movl %%edx, 4(%0) # store edx\n\t"
-  "movl %%eax, 0(%0) # store eax\n\t"
-  : :"r"(cycles) : "eax", "ebx", "ecx", "edx");
-}
-
 int compare( const void* a , const void* b ) {
   const uint64_t ai = *(uint64_t*)a;
   const uint64_t bi = *(uint64_t*)b;
@@ -82,13 +73,10 @@ int main(int argc, char *argv[]) {
     }
   }
 
-  volatile uint64_t start = 0;
-  volatile uint64_t end = 0;
   for (int i = 0; i < RUNS; i++) {
-    getcyclecount((uint64_t*) &start);
+    const uint64_t start = cycle_timer_start();
     Access(array, array_size);
-    getcyclecount((uint64_t*) &end);
-    cycles_runs[i] = end - start;
+    cycles_runs[i] = cycle_timer_stop() - start;
   }
 
   qsort(cycles_runs, RUNS, sizeof(uint64_t), compare);
@@ -0,0 +1,94 @@
+#include "access_patterns.h"
+#include "../../common/CycleTimer.h"
+#include "thread_utils.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// ---------------------------------------------------------------------------------------------------
+namespace {
+// ---------------------------------------------------------------------------------------------------
+constexpr int RUNS = 5;
+// ---------------------------------------------------------------------------------------------------
+}  // namespace
+// ---------------------------------------------------------------------------------------------------
+// Usage: cyclecounter_mt <working set exponent> <threads> [shared]
+// Every thread is pinned to its own cpu and chases a random ring of the given size. With shared = 0
+// (default) each thread has a private ring, so the threads compete for the shared caches and the
+// memory channels. With shared = 1 all threads chase the same ring, starting at different elements.
+// Prints: workingset(Bytes), threads, shared, cycles, bandwidth(Bytes/cycle)
+// cycles is the median cycles of one pass over the ring, averaged over the threads, bandwidth is the
+// aggregate of all threads, counting every element as one access.
+int main(int argc, char *argv[]) {
+  if (argc < 2 + 1 || argc > 3 + 1) {
+    return 1;
+  }
+  static_assert(sizeof(struct l) == 8, "8 bytes pro element");
+
+  const int working_set_exponent = atoi(argv[1]);
+  if (working_set_exponent < 8 || working_set_exponent > 30) {
+    return 3;
+  }
+  const int threads = atoi(argv[2]);
+  if (threads < 1) {
+    return 2;
+  }
+  const bool shared = argc > 3 && atoi(argv[3]) != 0;
+
+  const int working_set_size = 1 << working_set_exponent;
+  const int array_size = working_set_size / 8;
+
+  struct l *shared_array = nullptr;
+  if (shared) {
+    shared_array = (struct l *)malloc(array_size * sizeof(struct l));
+    Init_Random(shared_array, array_size);
+  }
+
+  SpinBarrier barrier(threads);
+  std::vector<uint64_t> cycles(threads);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&, t] {
+      PinThread(t);
+      struct l *array = shared_array;
+      if (!shared) {
+        // initialized by the pinned thread, so the ring is allocated on its node
+        array = (struct l *)malloc(array_size * sizeof(struct l));
+        Init_Random(array, array_size);
+      }
+      // threads of a shared ring start at different elements of the same cycle
+      struct l *first = shared ? array + static_cast<int64_t>(array_size) * t / threads : array;
+
+      uint64_t cycles_runs[RUNS];
+      for (int i = 0; i < RUNS; i++) {
+        barrier.Wait();
+        const uint64_t start = cycle_timer_start();
+        Access(first, array_size);
+        cycles_runs[i] = cycle_timer_stop() - start;
+      }
+      std::sort(cycles_runs, cycles_runs + RUNS);
+      cycles[t] = cycles_runs[RUNS / 2];
+      if (!shared) {
+        free(array);
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  uint64_t sum = 0, slowest = 0;
+  for (int t = 0; t < threads; t++) {
+    sum += cycles[t];
+    slowest = std::max(slowest, cycles[t]);
+  }
+  const double bandwidth = static_cast<double>(working_set_size) * threads / slowest;
+  printf("%d, %d, %d, %lu, %.3f\n", working_set_size, threads, shared ? 1 : 0, sum / threads, bandwidth);
+
+  free(shared_array);
+  return 0;
+}
@@ -1,7 +1,13 @@
 #include "PerfEvent.hpp"
 #include "access_patterns.h"
-
-int main() {
+#include "page_allocation.h"
+
+// Usage: perfevent [page backing], 0 := 4K | 1 := THP | 2 := 2M hugetlb | 3 := 1G hugetlb
+int main(int argc, char *argv[]) {
+  const Page_Backing backing = static_cast<Page_Backing>(argc > 1 ? atoi(argv[1]) : PAGES_REGULAR);
+  if (backing < PAGES_REGULAR || backing > PAGES_HUGETLB_1G) {
+    return 1;
+  }
   PerfEvent e;
 
   static_assert(sizeof(l) == 8);
@@ -14,7 +20,11 @@ int main() {
   const int stride_offset = stride_size / sizeof(l);
 
 
-  l array[array_size];
+  l *array = (l *)Allocate_Pages(working_set_size, backing);
+  if (array == nullptr) {
+    std::cerr << Page_Backing_Name(backing) << " pages not available" << std::endl;
+    return 2;
+  }
   const int inner_iter = array_size / stride_offset;
   const int outer_iter = array_size / inner_iter;
 
@@ -31,6 +41,7 @@ int main() {
   e.stopCounters();
   e.printReport(std::cout, 100); // use n as scale factor
   std::cout << std::endl;
+  Free_Pages(array, working_set_size, backing);
   return 0;
 }
 
@@ -54,3 +54,24 @@ target_link_libraries(
         lab
         gflags)
 
+
+# ---------------------------------------------------------------------------
+# CycleCounter (multi-threaded)
+# ---------------------------------------------------------------------------
+
+add_executable(cyclecounter_mt ${CMAKE_SOURCE_DIR}/src/CycleCounterMT.cc)
+target_link_libraries(
+        cyclecounter_mt
+        lab
+        gflags
+        Threads::Threads)
+
+# ---------------------------------------------------------------------------
+# CacheCalibrate
+# ---------------------------------------------------------------------------
+
+add_executable(cachecalibrate ${CMAKE_SOURCE_DIR}/src/CacheCalibrate.cc)
+target_link_libraries(
+        cachecalibrate
+        lab
+        gflags)
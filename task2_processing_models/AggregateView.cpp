@@ -0,0 +1,82 @@
+/**
+ * @file
+ *
+ * Implementation of incrementally maintained aggregates.
+ *
+ */
+
+#include <cassert>
+
+#include "AggregateView.h"
+#include "primitives.h"
+
+
+Tuple AggregateView::aggregateBlock ( Tuple* block, size_t n ) {
+    Tuple* in = block;
+    // the first predicate reads the relation, all following ones filter the scratch buffer in place
+    for ( auto& predicate : predicates ) {
+        switch ( predicate.first ) {
+            case SelectionOp::PredicateType::EQUALS:
+                n = compareEquals ( in, predicate.second, scratch.r, n );
+                break;
+            case SelectionOp::PredicateType::EQUALS_NOT:
+                n = compareNotEquals ( in, predicate.second, scratch.r, n );
+                break;
+            case SelectionOp::PredicateType::SMALLER:
+                n = compareSmaller ( in, predicate.second, scratch.r, n );
+                break;
+        }
+        in = scratch.r;
+    }
+    if ( this->type == AggregationOp::ReduceType::COUNT ) {
+        return aggCount ( in, n );
+    }
+    return aggSum ( in, n );
+}
+
+void AggregateView::addPredicate ( SelectionOp::PredicateType predType, int compareConstant ) {
+    predicates.emplace_back ( predType, compareConstant );
+    invalidate();
+}
+
+void AggregateView::invalidate () {
+    aggregate = 0;
+    viewLen = 0;
+}
+
+size_t AggregateView::refresh ( Relation rel ) {
+    assert ( rel.len >= viewLen );
+    if ( rel.len == viewLen ) {
+        return 0;
+    }
+
+    // the covered tuples never change and SUM and COUNT are distributive,
+    // so only the appended tuples are added to the aggregate
+    size_t aggregated = rel.len - viewLen;
+    for ( size_t start = viewLen; start < rel.len; start += VIEW_BLOCK_SIZE ) {
+        size_t n = ( start + VIEW_BLOCK_SIZE <= rel.len ) ? VIEW_BLOCK_SIZE : rel.len - start;
+        aggregate += aggregateBlock ( rel.r + start, n );
+    }
+    viewLen = rel.len;
+    return aggregated;
+}
+
+
+AggregateViews::~AggregateViews() {
+    for ( auto view : views ) {
+        delete view;
+    }
+}
+
+AggregateView* AggregateViews::registerView ( AggregationOp::ReduceType type ) {
+    views.push_back ( new AggregateView ( type ) );
+    return views.back();
+}
+
+size_t AggregateViews::refresh ( Relation rel ) {
+    size_t aggregated = 0;
+    for ( auto view : views ) {
+        aggregated += view->refresh ( rel );
+    }
+    return aggregated;
+}
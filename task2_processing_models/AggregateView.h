@@ -0,0 +1,111 @@
+/**
+ * @file
+ *
+ * Incrementally maintained aggregates over append-only relations.
+ *
+ */
+
+#pragma once
+
+#include <vector>
+#include <utility>
+
+#include "DBData.h"
+#include "Operators.h"
+
+/* Number of tuples a view filters and aggregates at once, the size of its scratch buffer. */
+static constexpr size_t VIEW_BLOCK_SIZE = 64 * BATCH_SIZE;
+
+/**
+ * @brief Materialized aggregate over a conjunctive selection of an append-only relation.
+ * Since tuples are only appended and SUM and COUNT are distributive, a refresh only
+ * aggregates the tuples appended since the last refresh, in blocks of VIEW_BLOCK_SIZE tuples,
+ * and adds them to the current value.
+ * E.g. SELECT SUM(x) FROM rel WHERE x <> 11 AND x <> 42 is registered as
+ *
+ *   AggregateView view ( AggregationOp::SUM );
+ *   view.addPredicate ( SelectionOp::PredicateType::EQUALS_NOT, 11 );
+ *   view.addPredicate ( SelectionOp::PredicateType::EQUALS_NOT, 42 );
+ */
+class AggregateView {
+protected:
+    AggregationOp::ReduceType type;
+    std::vector<std::pair<SelectionOp::PredicateType, int>> predicates;
+
+    /* aggregate over all covered tuples */
+    Tuple aggregate = 0;
+    /* tuples covered by the view */
+    size_t viewLen = 0;
+
+    /* buffer for the qualifying tuples of one block */
+    Relation scratch;
+
+    /* aggregate the qualifying tuples of one block */
+    Tuple aggregateBlock ( Tuple* block, size_t n );
+
+public:
+    AggregateView ( AggregationOp::ReduceType type ) {
+        this->type = type;
+        this->scratch = allocateRelation ( VIEW_BLOCK_SIZE );
+    }
+
+    ~AggregateView() {
+        freeRelation ( this->scratch );
+    }
+
+    AggregateView ( const AggregateView& ) = delete;
+    AggregateView& operator= ( const AggregateView& ) = delete;
+
+    /**
+     * @brief Add a predicate to the conjunctive filter of the view.
+     * Invalidates the view, so it is recomputed by the next refresh.
+     */
+    void addPredicate ( SelectionOp::PredicateType predType, int compareConstant );
+
+    /**
+     * @brief Bring the view up to date with rel, which may have grown since the last refresh.
+     * Returns the number of tuples that were aggregated.
+     */
+    size_t refresh ( Relation rel );
+
+    /**
+     * @brief Drop the aggregate, the next refresh recomputes the view from scratch.
+     */
+    void invalidate ();
+
+    /**
+     * @brief Current value of the aggregate, does not touch the relation.
+     */
+    Tuple get () {
+        return aggregate;
+    }
+
+    /**
+     * @brief Number of tuples covered by the current value.
+     */
+    size_t size () {
+        return viewLen;
+    }
+};
+
+
+/**
+ * @brief Set of views registered for one append-only relation, refreshed together.
+ */
+class AggregateViews {
+protected:
+    std::vector<AggregateView*> views;
+
+public:
+    ~AggregateViews();
+
+    /**
+     * @brief Register a new view, the registry owns the returned view.
+     */
+    AggregateView* registerView ( AggregationOp::ReduceType type );
+
+    /**
+     * @brief Refresh all views with the appended part of rel and return the aggregated tuples.
+     */
+    size_t refresh ( Relation rel );
+};
@@ -24,3 +24,8 @@ void RelOperator::deletePlan() {
     }
     delete ( this );
 }
+
+
+bool RelOperator::fingerprint ( PlanFingerprint& fp ) {
+    return false;
+}
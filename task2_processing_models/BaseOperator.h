@@ -15,6 +15,17 @@
 
 #include "DBData.h"
 
+/**
+ * @brief Canonical description of a query plan and the data it reads.
+ * Plans computing the same result have the same key, e.g. independent of the order of
+ * conjunctive predicates. The key contains the version of every source, so it changes
+ * whenever an input file is rewritten.
+ */
+struct PlanFingerprint {
+    std::string key;
+    std::vector<DataSource> sources;
+};
+
 /**
  * @brief The operator base class
  * Super class for all operators. Serves as an interface for the supported processing models:
@@ -38,6 +49,9 @@ protected:
 
 public:
 
+    /* Number of tuples per vector in vector-at-a-time execution, applies to plans built afterwards */
+    static size_t batchSize;
+
     /* Set child parent/child pointer */
     RelOperator ( RelOperator *c );
 
@@ -93,6 +107,13 @@ public:
      */
     virtual size_t getSize ()   = 0;
 
+    /**
+     * @brief Append the canonical description of the plan rooted at this operator to fp.
+     * Returns false if the result of the plan cannot be identified, e.g. if it reads
+     * from a relation which is not stored in a mapped file. Default: not identifiable.
+     */
+    virtual bool fingerprint ( PlanFingerprint& fp );
+
     /**
      * Volcano style interface
      */
@@ -0,0 +1,391 @@
+/**
+ * @file
+ *
+ * Benchmark driver sweeping relation size, query, processing model, thread count and batch size
+ * at runtime. Every point is repeated and reported with median/p95 time and perf counters.
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DBData.h"
+#include "MorselScan.h"
+#include "Numa.h"
+#include "Operators.h"
+#include "Queries.h"
+#include "SharedScan.h"
+#include "Timer.h"
+#include "PerfEvent.hpp"
+
+
+enum class Model { VOLCANO, OPERATOR, VECTOR, BITMAP, FUSED, SHARED, MORSEL };
+
+static const char* modelNames[] = { "vol", "op", "vec", "bm", "fused", "shared", "morsel" };
+
+static const char* placementNames[] = { "none", "interleave", "chunked" };
+
+
+/**
+  * @brief Parameters of the sweep, every combination is one point.
+  */
+struct BenchmarkConfig {
+    std::vector<size_t> sizes { 1000000 };
+    std::vector<size_t> queries { 0, 1, 2, 3 };
+    std::vector<Model> models { Model::VOLCANO, Model::OPERATOR, Model::VECTOR, Model::BITMAP, Model::FUSED };
+    std::vector<size_t> threads { 1 };
+    std::vector<size_t> batches { BATCH_SIZE };
+    size_t reps = 5;
+    NumaPlacement placement = NumaPlacement::NONE;
+    bool json = false;
+    std::string dbFile = "bench.dat";
+    std::string outFile;
+};
+
+
+/**
+  * @brief Measurements of one point.
+  */
+struct BenchmarkResult {
+    size_t size, query, threads, batch, reps;
+    Model model;
+    Tuple result;
+    double median, p95, min;
+    /* morsels processed on their own node and stolen from other nodes, per repetition */
+    double localMorsels = 0, remoteMorsels = 0;
+    std::vector<std::string> counterNames;
+    std::vector<double> counters;
+};
+
+
+/**
+  * @brief Parse a number with optional K/M/G suffix (powers of 1000).
+  */
+static size_t parseSize ( const std::string& s ) {
+    char* end;
+    double value = strtod ( s.c_str(), &end );
+    switch ( *end ) {
+        case 'k': case 'K': value *= 1e3; break;
+        case 'm': case 'M': value *= 1e6; break;
+        case 'g': case 'G': value *= 1e9; break;
+    }
+    return static_cast<size_t> ( value );
+}
+
+
+/**
+  * @brief Split a comma separated list.
+  */
+static std::vector<std::string> splitList ( const std::string& s ) {
+    std::vector<std::string> items;
+    std::stringstream stream ( s );
+    std::string item;
+    while ( std::getline ( stream, item, ',' ) ) {
+        if ( !item.empty() ) items.push_back ( item );
+    }
+    return items;
+}
+
+
+static std::vector<size_t> parseSizes ( const std::string& s ) {
+    std::vector<size_t> values;
+    for ( auto& item : splitList ( s ) ) values.push_back ( parseSize ( item ) );
+    return values;
+}
+
+
+static void usage ( const char* name ) {
+    std::cout << "usage: " << name << " [options]" << std::endl
+              << "  --sizes   n[,n..]      relation sizes in tuples, suffix K/M/G (default 1M)" << std::endl
+              << "  --queries q[,q..]      queries 0-3 (default all)" << std::endl
+              << "  --models  m[,m..]      vol, op, vec, bm, fused, shared, morsel (default vol to fused)" << std::endl
+              << "  --threads t[,t..]      concurrent instances of the query (default 1)" << std::endl
+              << "  --batches b[,b..]      vector sizes for vec, shared and morsel (default " << BATCH_SIZE << ")" << std::endl
+              << "  --reps    r            repetitions per point (default 5)" << std::endl
+              << "  --numa    none|interleave|chunked   page placement of the relation (default none)" << std::endl
+              << "  --format  csv|json     output format (default csv)" << std::endl
+              << "  --file    path         relation file, reused by all points and runs (default bench.dat)" << std::endl
+              << "  --out     path         write results to path instead of stdout" << std::endl;
+}
+
+
+static bool parseArgs ( int argc, char* argv[], BenchmarkConfig& config ) {
+    for ( int i = 1; i < argc; i++ ) {
+        std::string arg = argv[i];
+        if ( arg == "--help" || i + 1 >= argc ) {
+            return false;
+        }
+        std::string value = argv[++i];
+        if ( arg == "--sizes" ) {
+            config.sizes = parseSizes ( value );
+        } else if ( arg == "--queries" ) {
+            config.queries = parseSizes ( value );
+            for ( size_t q : config.queries ) {
+                if ( q > 3 ) return false;
+            }
+        } else if ( arg == "--models" ) {
+            config.models.clear();
+            for ( auto& item : splitList ( value ) ) {
+                auto it = std::find_if ( std::begin ( modelNames ), std::end ( modelNames ),
+                                         [&] ( const char* name ) { return item == name; } );
+                if ( it == std::end ( modelNames ) ) return false;
+                config.models.push_back ( static_cast<Model> ( it - std::begin ( modelNames ) ) );
+            }
+        } else if ( arg == "--threads" ) {
+            config.threads = parseSizes ( value );
+        } else if ( arg == "--batches" ) {
+            config.batches = parseSizes ( value );
+        } else if ( arg == "--reps" ) {
+            config.reps = parseSize ( value );
+        } else if ( arg == "--numa" ) {
+            auto it = std::find ( std::begin ( placementNames ), std::end ( placementNames ), value );
+            if ( it == std::end ( placementNames ) ) return false;
+            config.placement = static_cast<NumaPlacement> ( it - std::begin ( placementNames ) );
+        } else if ( arg == "--format" ) {
+            config.json = ( value == "json" );
+        } else if ( arg == "--file" ) {
+            config.dbFile = value;
+        } else if ( arg == "--out" ) {
+            config.outFile = value;
+        } else {
+            return false;
+        }
+    }
+    return !( config.sizes.empty() || config.queries.empty() || config.models.empty() ||
+              config.threads.empty() || config.batches.empty() || config.reps == 0 );
+}
+
+
+/**
+  * @brief Execute one plan with the given model and return the aggregate, or the number of result tuples.
+  */
+static Tuple runPlan ( RelOperator* root, Model model ) {
+    Relation result;
+    bool owned = false;
+    switch ( model ) {
+        case Model::VOLCANO:
+            result = allocateRelation ( root->getSize() );
+            owned = true;
+            PullDriver::volcano ( root, &result );
+            break;
+        case Model::VECTOR:
+        case Model::SHARED:
+        case Model::MORSEL:
+            result = allocateRelation ( root->getSize() );
+            owned = true;
+            PullDriver::vectorization ( root, &result );
+            break;
+        case Model::OPERATOR:
+        case Model::BITMAP:
+        case Model::FUSED:
+            result = root->getRelation();
+            break;
+    }
+    bool aggregate = ( dynamic_cast<AggregationOp*> ( root ) != nullptr );
+    // an aggregate over no tuples (e.g., a morsel worker that got no morsel) has an empty result
+    Tuple value = aggregate ? ( result.len > 0 ? result.r[0] : 0 ) : (Tuple) result.len;
+    if ( owned ) {
+        freeRelation ( result );
+    }
+    return value;
+}
+
+
+/**
+  * @brief Run one point of the sweep reps times, each time with freshly built plans.
+  */
+static BenchmarkResult runPoint ( Relation relation, size_t query, Model model, size_t threads, size_t batch, size_t reps ) {
+    BenchmarkResult res;
+    res.size = relation.len; res.query = query; res.model = model;
+    res.threads = threads; res.batch = batch; res.reps = reps;
+
+    RelOperator::batchSize = ( batch > 0 ) ? batch : BATCH_SIZE;
+    SelectionOp::filterMode = ( model == Model::BITMAP ) ? SelectionOp::FilterMode::BITMAP :
+                              ( model == Model::FUSED ) ? SelectionOp::FilterMode::FUSED :
+                                                          SelectionOp::FilterMode::MATERIALIZE;
+
+    PerfEvent e;
+    res.counterNames = e.names;
+    res.counters.assign ( e.names.size(), 0.0 );
+    std::vector<double> times;
+    std::vector<Tuple> values ( threads );
+
+    for ( size_t rep = 0; rep < reps; rep++ ) {
+        SharedScan sharedScan ( relation.r, relation.len );
+        MorselQueue morselQueue ( relation.r, relation.len );
+        std::vector<RelOperator*> plans;
+        std::vector<std::array<RelOperator*, 4>> all;
+        for ( size_t t = 0; t < threads; t++ ) {
+            // morsel workers are spread round robin across the nodes
+            int node = t % morselQueue.getNumNodes();
+            all.push_back ( buildQuerys ( relation, model == Model::SHARED ? &sharedScan : nullptr,
+                                          model == Model::MORSEL ? &morselQueue : nullptr, node ) );
+            plans.push_back ( all.back()[query] );
+        }
+
+        Timer timer = Timer();
+        e.startCounters();
+        if ( threads == 1 && model != Model::MORSEL ) {
+            values[0] = runPlan ( plans[0], model );
+        } else {
+            std::vector<std::thread> workers;
+            for ( size_t t = 0; t < threads; t++ ) {
+                workers.emplace_back ( [&, t] {
+                    if ( model == Model::MORSEL ) {
+                        numaPinThread ( t % morselQueue.getNumNodes() );
+                    }
+                    values[t] = runPlan ( plans[t], model );
+                } );
+            }
+            for ( auto& worker : workers ) {
+                worker.join();
+            }
+        }
+        e.stopCounters();
+        times.push_back ( timer.get() );
+        for ( size_t c = 0; c < e.names.size(); c++ ) {
+            res.counters[c] += e.values[c];
+        }
+        res.localMorsels += morselQueue.getLocalMorsels() / static_cast<double> ( reps );
+        res.remoteMorsels += morselQueue.getRemoteMorsels() / static_cast<double> ( reps );
+
+        for ( auto& querys : all ) {
+            for ( auto q : querys ) {
+                q->deletePlan();
+            }
+        }
+    }
+    SelectionOp::filterMode = SelectionOp::FilterMode::MATERIALIZE;
+    RelOperator::batchSize = BATCH_SIZE;
+
+    // counters per tuple of the relation and query instance
+    double scale = static_cast<double> ( relation.len ) * threads * reps;
+    for ( auto& counter : res.counters ) {
+        counter /= scale;
+    }
+    std::sort ( times.begin(), times.end() );
+    res.min = times.front();
+    res.median = ( times.size() % 2 == 1 ) ? times[times.size() / 2]
+                                           : ( times[times.size() / 2 - 1] + times[times.size() / 2] ) / 2;
+    res.p95 = times[static_cast<size_t> ( std::ceil ( 0.95 * times.size() ) ) - 1];
+    // every morsel worker computed the query on a part of the table, combine the partial results
+    res.result = values[0];
+    if ( model == Model::MORSEL ) {
+        for ( size_t t = 1; t < threads; t++ ) {
+            res.result += values[t];
+        }
+    }
+    return res;
+}
+
+
+/**
+  * @brief Share of the morsels processed on their own node, negative if the point did not use morsels.
+  */
+static double localRatio ( const BenchmarkResult& res ) {
+    double morsels = res.localMorsels + res.remoteMorsels;
+    return ( morsels > 0 ) ? res.localMorsels / morsels : -1.0;
+}
+
+
+static void printCsv ( std::ostream& out, const BenchmarkResult& res, const char* placement, bool header ) {
+    if ( header ) {
+        out << "size,query,model,threads,batch,reps,placement,result,median_ms,p95_ms,min_ms,"
+            << "local_morsels,remote_morsels,local_ratio";
+        for ( auto& name : res.counterNames ) out << "," << name;
+        out << std::endl;
+    }
+    out << std::fixed << std::setprecision(3);
+    out << res.size << "," << res.query << "," << modelNames[static_cast<int> ( res.model )] << ","
+        << res.threads << "," << res.batch << "," << res.reps << "," << placement << "," << res.result << ","
+        << res.median << "," << res.p95 << "," << res.min << ","
+        << res.localMorsels << "," << res.remoteMorsels << "," << localRatio ( res );
+    for ( double counter : res.counters ) out << "," << counter;
+    out << std::endl;
+}
+
+
+static void printJson ( std::ostream& out, const BenchmarkResult& res, const char* placement, bool first ) {
+    out << ( first ? "[\n" : ",\n" );
+    out << std::fixed << std::setprecision(3);
+    out << "  {\"size\": " << res.size << ", \"query\": " << res.query
+        << ", \"model\": \"" << modelNames[static_cast<int> ( res.model )] << "\""
+        << ", \"threads\": " << res.threads << ", \"batch\": " << res.batch << ", \"reps\": " << res.reps
+        << ", \"placement\": \"" << placement << "\"" << ", \"result\": " << res.result
+        << ", \"median_ms\": " << res.median << ", \"p95_ms\": " << res.p95 << ", \"min_ms\": " << res.min
+        << ", \"local_morsels\": " << res.localMorsels << ", \"remote_morsels\": " << res.remoteMorsels
+        << ", \"local_ratio\": " << localRatio ( res )
+        << ", \"counters\": {";
+    for ( size_t c = 0; c < res.counters.size(); c++ ) {
+        out << ( c > 0 ? ", " : "" ) << "\"" << res.counterNames[c] << "\": " << res.counters[c];
+    }
+    out << "}}";
+}
+
+
+/**
+  * @brief Parse the sweep, map (or generate once) the largest relation and run all points on prefixes of it.
+  */
+int main ( int argc, char* argv[] ) {
+    BenchmarkConfig config;
+    if ( !parseArgs ( argc, argv, config ) ) {
+        usage ( argv[0] );
+        return 1;
+    }
+
+    // all sizes are prefixes of one relation, which is kept in the file between runs
+    size_t maxLen = *std::max_element ( config.sizes.begin(), config.sizes.end() );
+    Relation relation;
+    if ( !loadData ( &relation, config.dbFile.c_str(), maxLen, true ) ) {
+        std::cerr << "Generating data.." << std::endl;
+        genData ( &relation, config.dbFile.c_str(), maxLen );
+    }
+    const char* placement = placementNames[static_cast<int> ( config.placement )];
+    if ( !numaPlaceRelation ( relation, config.placement ) ) {
+        std::cerr << "Placing the relation " << placement << " failed, keeping the default placement" << std::endl;
+        placement = "none";
+    }
+
+    std::ofstream file;
+    if ( !config.outFile.empty() ) {
+        file.open ( config.outFile );
+    }
+    std::ostream& out = config.outFile.empty() ? std::cout : file;
+
+    bool first = true;
+    for ( size_t size : config.sizes ) {
+        Relation prefix = relation;
+        prefix.len = size;
+        for ( size_t query : config.queries ) {
+            for ( Model model : config.models ) {
+                // the vector size only matters for the vectorized models
+                bool vectorized = ( model == Model::VECTOR || model == Model::SHARED || model == Model::MORSEL );
+                std::vector<size_t> batches = vectorized ? config.batches : std::vector<size_t> { 0 };
+                for ( size_t threads : config.threads ) {
+                    for ( size_t batch : batches ) {
+                        BenchmarkResult res = runPoint ( prefix, query, model, threads, batch, config.reps );
+                        if ( config.json ) {
+                            printJson ( out, res, placement, first );
+                        } else {
+                            printCsv ( out, res, placement, first );
+                        }
+                        first = false;
+                    }
+                }
+            }
+        }
+    }
+    if ( config.json ) {
+        out << "\n]" << std::endl;
+    }
+    return 0;
+}
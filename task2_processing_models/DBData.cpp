@@ -9,11 +9,28 @@
  */
  
 #include <iostream>
+#include <map>
 #include <stdlib.h>
 #include "DBData.h"
 #include "mappedmalloc.h"
 
 
+/* version per file and file per mapped relation */
+static std::map<std::string, uint64_t> fileVersions;
+static std::map<const Tuple*, std::string> mappedFiles;
+static uint64_t dataEpoch = 0;
+
+/* record that filepath changed, mapped at r afterwards (or not at all if r is nullptr) */
+static void updateDataSource ( const Tuple* oldR, const Tuple* r, const char* filepath ) {
+    mappedFiles.erase ( oldR );
+    if ( r != nullptr ) {
+        mappedFiles[r] = filepath;
+    }
+    fileVersions[filepath]++;
+    dataEpoch++;
+}
+
+
 Relation allocateRelation ( size_t capacity ) {
     Relation col;
     col.len = 0;
@@ -36,10 +53,32 @@ void genData ( Relation* out, const char* filepath, size_t len ) {
     for(size_t i=0; i<len; i++) {
         out->r[i]=rand()%100;
     }
+    updateDataSource ( nullptr, out->r, filepath );
+}
+
+
+void appendData ( Relation* out, const char* filepath, size_t n ) {
+    size_t len = out->len + n;
+    Tuple* oldR = out->r;
+    out->r = (Tuple*) extend_memory_mapped_file ( out->r, sizeof(Tuple) * len, filepath );
+    for(size_t i=out->len; i<len; i++) {
+        out->r[i]=rand()%100;
+    }
+    out->len = len;
+    updateDataSource ( oldR, out->r, filepath );
+}
+
+
+void dropData ( Relation* rel, const char* filepath ) {
+    unmap_memory_file ( rel->r );
+    free_memory_mapped_file ( filepath );
+    updateDataSource ( rel->r, nullptr, filepath );
+    rel->r = nullptr;
+    rel->len = 0;
 }
 
 
-bool loadData ( Relation* out, const char* filepath, size_t len ) {
+bool loadData ( Relation* out, const char* filepath, size_t len, bool prefix ) {
     if( access( filepath, F_OK ) == -1 ) {
         std::cout << "Cannot access file" << std::endl;
         return false;
@@ -47,13 +86,36 @@ bool loadData ( Relation* out, const char* filepath, size_t len ) {
     size_t lenBytes;
     out->r = (Tuple*) map_memory_file ( filepath, &lenBytes );
     out->len = lenBytes / sizeof ( Tuple );
-    if ( out->len != len ) {
+    if ( prefix ? out->len < len : out->len != len ) {
         std::cout << "Size mismatch out->len: " << out->len << ", REL_LEN: " << len << std::endl;
         unmap_memory_file ( out->r );
         free_memory_mapped_file ( filepath );
         return false;
     }
+    mappedFiles[out->r] = filepath;
+    return true;
+}
+
+
+bool getDataSource ( const Tuple* r, DataSource* out ) {
+    auto it = mappedFiles.find ( r );
+    if ( it == mappedFiles.end() ) {
+        return false;
+    }
+    out->filepath = it->second;
+    out->version = getDataVersion ( it->second );
     return true;
 }
 
 
+uint64_t getDataVersion ( const std::string& filepath ) {
+    auto it = fileVersions.find ( filepath );
+    return ( it == fileVersions.end() ) ? 0 : it->second;
+}
+
+
+uint64_t getDataEpoch () {
+    return dataEpoch;
+}
+
+
@@ -12,6 +12,8 @@
 
 #include <cstddef>
 #include <cassert>
+#include <cstdint>
+#include <string>
 
 typedef long int Tuple;
 static_assert(sizeof(long int) == 8);
@@ -24,6 +26,16 @@ typedef struct Relation {
 } Relation;
 
 
+/**
+  * @brief Identity of the memory mapped file a relation is stored in.
+  * The version is increased whenever the file is generated, appended to or dropped.
+  */
+typedef struct DataSource {
+    std::string filepath;
+    uint64_t version;
+} DataSource;
+
+
 /**
   * @brief Allocate tuple array and initialize Relation attributes.
   */
@@ -44,10 +56,43 @@ void freeRelation ( Relation col );
 void genData ( Relation* out, const char* filepath, size_t len );
 
 
+/**
+  * @brief Append n tuples with uniform distribution to the relation in the memory mapped file.
+  * The file is remapped, so out->r may change. Existing tuples are not modified.
+  */
+void appendData ( Relation* out, const char* filepath, size_t n );
+
+
+/**
+  * @brief Unmap relation and delete the memory mapped file.
+  */
+void dropData ( Relation* rel, const char* filepath );
+
+
 /**
   * @brief Load relation from memory mapped fill into out.
   * Returns whether loading and size verification was successful.
+  * With prefix set, a file holding more than len tuples is accepted as well and out gets the full length.
+  */
+bool loadData ( Relation* out, const char* filepath, size_t len, bool prefix = false );
+
+
+/**
+  * @brief Lookup the file a mapped relation starting at r is stored in.
+  * Returns false, if r does not belong to a relation from genData, loadData or appendData.
+  */
+bool getDataSource ( const Tuple* r, DataSource* out );
+
+
+/**
+  * @brief Current version of the file, see DataSource.
+  */
+uint64_t getDataVersion ( const std::string& filepath );
+
+
+/**
+  * @brief Counter increased with every change of any file, allows to cheaply detect changes.
   */
-bool loadData ( Relation* out, const char* filepath, size_t len );
+uint64_t getDataEpoch ();
 
 
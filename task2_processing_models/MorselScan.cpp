@@ -0,0 +1,121 @@
+/**
+ * @file
+ *
+ * Implementation of the morsel dispatcher and the morsel scan operator for all processing models.
+ *
+ */
+
+#include <algorithm>
+
+#include "MorselScan.h"
+#include "Numa.h"
+#include "primitives.h"
+
+
+MorselQueue::MorselQueue ( Tuple* tab, size_t n ) {
+    this->table = tab;
+    this->tableSize = n;
+    this->numNodes = numaNodes();
+    this->queues.reset ( new NodeQueue[numNodes] );
+
+    size_t numMorsels = ( n + MORSEL_SIZE - 1 ) / MORSEL_SIZE;
+    std::vector<const void*> starts;
+    for ( size_t m = 0; m < numMorsels; m++ ) {
+        starts.push_back ( table + m * MORSEL_SIZE );
+    }
+    std::vector<int> nodes = numaNodesOf ( starts );
+    for ( size_t m = 0; m < numMorsels; m++ ) {
+        // pages of unknown location are split evenly, as a chunked placement would do
+        size_t node = ( nodes[m] >= 0 && static_cast<size_t> ( nodes[m] ) < numNodes ) ?
+                      nodes[m] : m * numNodes / numMorsels;
+        queues[node].morsels.push_back ( m * MORSEL_SIZE );
+    }
+    reset();
+}
+
+void MorselQueue::reset () {
+    for ( size_t node = 0; node < numNodes; node++ ) {
+        queues[node].cursor = 0;
+    }
+    localMorsels = 0;
+    remoteMorsels = 0;
+}
+
+Tuple* MorselQueue::next ( int node, size_t* len ) {
+    // own node first, then steal from the other nodes in round robin order
+    for ( size_t i = 0; i < numNodes; i++ ) {
+        NodeQueue& q = queues[( node + i ) % numNodes];
+        if ( q.cursor.load ( std::memory_order_relaxed ) >= q.morsels.size() ) {
+            continue;
+        }
+        size_t m = q.cursor.fetch_add ( 1 );
+        if ( m >= q.morsels.size() ) {
+            continue;
+        }
+        ( i == 0 ? localMorsels : remoteMorsels )++;
+        size_t start = q.morsels[m];
+        *len = std::min ( MORSEL_SIZE, tableSize - start );
+        return table + start;
+    }
+    return nullptr;
+}
+
+
+bool MorselScanOp::fetchMorsel () {
+    morsel = queue->next ( node, &morselLen );
+    cursor = 0;
+    if ( morsel == nullptr ) {
+        morselLen = 0;
+        return false;
+    }
+    return true;
+}
+
+
+void MorselScanOp::open() {
+    morsel = nullptr;
+    morselLen = 0;
+    cursor = 0;
+}
+
+Tuple* MorselScanOp::next() {
+    if ( cursor >= morselLen && !fetchMorsel() ) {
+        return nullptr;
+    }
+    return &morsel[cursor++];
+}
+
+void MorselScanOp::close() {}
+
+
+Relation MorselScanOp::getRelation() {
+    size_t len = 0;
+    while ( fetchMorsel() ) {
+        len += scanLong ( morsel, oCol.r + len, morselLen );
+    }
+    oCol.len = len;
+    return oCol;
+}
+
+
+void MorselScanOp::openVec() {
+    open();
+    oCol.len = 0;
+    oCol.start_offset = 0;
+}
+
+Relation& MorselScanOp::nextVec() {
+    if ( this->oCol.start_offset != 0 ) {
+        // Return the rest cached elements
+        return oCol;
+    }
+    if ( cursor >= morselLen && !fetchMorsel() ) {
+        oCol.len = 0;
+        return oCol;
+    }
+    oCol.len = scanLong ( morsel + cursor, oCol.r, std::min ( batchSize, morselLen - cursor ) );
+    cursor += oCol.len;
+    return oCol;
+}
+
+void MorselScanOp::closeVec() {}
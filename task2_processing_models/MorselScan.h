@@ -0,0 +1,138 @@
+/**
+ * @file
+ *
+ * NUMA-aware morsel-driven parallel scan of one relation.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "BaseOperator.h"
+#include "DBData.h"
+#include "Operators.h"
+
+/* Number of vectors per morsel. Large enough to amortize the atomic dispatch, small enough to
+ * balance the load at the end of the scan. */
+static constexpr size_t MORSEL_BATCHES = 16;
+static constexpr size_t MORSEL_SIZE = MORSEL_BATCHES * BATCH_SIZE;
+
+/**
+ * @brief Dispatcher of the morsels of a table to the workers of a parallel scan.
+ * Every morsel is assigned to the NUMA node its first page resides on. Workers take the morsels
+ * of their own node first and only steal morsels of other nodes once their own node runs dry,
+ * i.e., at the tail of the scan. Each morsel is handed out exactly once.
+ */
+class MorselQueue {
+protected:
+    struct NodeQueue {
+        /* start tuple of the morsels on this node, in table order */
+        std::vector<size_t> morsels;
+        /* next morsel to hand out */
+        std::atomic<size_t> cursor;
+        /* keep the cursors of different nodes on different cache lines */
+        char padding[64];
+    };
+
+    Tuple* table;
+    size_t tableSize;
+    size_t numNodes;
+    std::unique_ptr<NodeQueue[]> queues;
+
+    std::atomic<size_t> localMorsels;
+    std::atomic<size_t> remoteMorsels;
+
+public:
+    MorselQueue ( Tuple* tab, size_t n );
+
+    size_t getSize () {
+        return tableSize;
+    }
+
+    size_t getNumNodes () {
+        return numNodes;
+    }
+
+    /**
+     * @brief Morsels assigned to node.
+     */
+    size_t getNumMorsels ( int node ) {
+        return queues[node].morsels.size();
+    }
+
+    /**
+     * @brief Hand out the next morsel for a worker on node.
+     * Returns a pointer to the morsel and writes its length to len, or nullptr if the scan is done.
+     */
+    Tuple* next ( int node, size_t* len );
+
+    /**
+     * @brief Make all morsels available again and reset the statistics.
+     */
+    void reset ();
+
+    /**
+     * @brief Morsels handed out to a worker on their own node.
+     */
+    size_t getLocalMorsels () {
+        return localMorsels;
+    }
+
+    /**
+     * @brief Morsels stolen by a worker on another node.
+     */
+    size_t getRemoteMorsels () {
+        return remoteMorsels;
+    }
+};
+
+
+/**
+ * @brief Leaf operator of one worker of a parallel scan, reading the morsels it gets from a MorselQueue.
+ * Each worker runs its own copy of the plan on the part of the table it receives, so the results
+ * of all workers have to be combined, e.g., by adding up partial sums.
+ */
+class MorselScanOp : public RelOperator {
+protected:
+    MorselQueue* queue;
+    int node;
+
+    /* current morsel */
+    Tuple* morsel = nullptr;
+    size_t morselLen = 0;
+    size_t cursor = 0;
+    /* operator-at-a-time (and vector-at-a-time) */
+    Relation oCol;
+
+    /* get the next morsel, returns false if the scan is done */
+    bool fetchMorsel ();
+
+public:
+    MorselScanOp ( MorselQueue* queue, int node ) : RelOperator ( nullptr ) {
+        this->queue = queue;
+        this->node = node;
+        this->oCol = allocateRelation ( queue->getSize() );
+    }
+
+    virtual ~MorselScanOp() {
+        freeRelation ( this->oCol );
+    }
+
+    virtual size_t getSize () {
+        return queue->getSize();
+    }
+
+    virtual void open();
+    virtual Tuple* next();
+    virtual void close();
+
+    virtual Relation getRelation();
+
+    virtual void openVec();
+    virtual Relation& nextVec();
+    virtual void closeVec();
+};
@@ -0,0 +1,144 @@
+/**
+ * @file
+ *
+ * Implementation of the NUMA helpers on top of sysfs and the mbind/move_pages system calls,
+ * so no libnuma is required.
+ *
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+#include "Numa.h"
+
+
+static const std::string NODE_PATH = "/sys/devices/system/node/node";
+
+/* bits of the node masks passed to mbind */
+static constexpr size_t MAX_NODES = 64;
+
+
+size_t numaNodes () {
+    static size_t nodes = 0;
+    if ( nodes == 0 ) {
+        while ( nodes < MAX_NODES && access ( ( NODE_PATH + std::to_string ( nodes ) ).c_str(), F_OK ) == 0 ) {
+            nodes++;
+        }
+        if ( nodes == 0 ) {
+            nodes = 1;
+        }
+    }
+    return nodes;
+}
+
+
+std::vector<int> numaNodeCpus ( int node ) {
+    std::vector<int> cpus;
+    std::ifstream file ( NODE_PATH + std::to_string ( node ) + "/cpulist" );
+    std::string range;
+    // cpulist is a comma separated list of ranges, e.g., 0-3,8-11
+    while ( std::getline ( file, range, ',' ) ) {
+        int first, last;
+        char dash;
+        std::istringstream stream ( range );
+        if ( !( stream >> first ) ) {
+            continue;
+        }
+        last = ( stream >> dash >> last ) ? last : first;
+        for ( int cpu = first; cpu <= last; cpu++ ) {
+            cpus.push_back ( cpu );
+        }
+    }
+    if ( cpus.empty() && numaNodes() == 1 ) {
+        // no sysfs, all CPUs are on the only node
+        for ( long cpu = 0; cpu < sysconf ( _SC_NPROCESSORS_ONLN ); cpu++ ) {
+            cpus.push_back ( cpu );
+        }
+    }
+    return cpus;
+}
+
+
+bool numaPinThread ( int node ) {
+    std::vector<int> cpus = numaNodeCpus ( node );
+    if ( cpus.empty() ) {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO ( &set );
+    for ( int cpu : cpus ) {
+        CPU_SET ( cpu, &set );
+    }
+    return pthread_setaffinity_np ( pthread_self(), sizeof ( set ), &set ) == 0;
+}
+
+
+int numaCurrentNode () {
+    unsigned cpu, node;
+    if ( syscall ( SYS_getcpu, &cpu, &node, nullptr ) != 0 ) {
+        return 0;
+    }
+    return static_cast<int> ( node );
+}
+
+
+/* apply mode for nodes in mask to the page aligned range [begin, end) */
+static bool bindRange ( char* begin, char* end, int mode, unsigned long mask ) {
+    if ( begin >= end ) {
+        return true;
+    }
+    return syscall ( SYS_mbind, begin, end - begin, mode, &mask, MAX_NODES + 1, MPOL_MF_MOVE ) == 0;
+}
+
+
+bool numaPlaceRelation ( Relation rel, NumaPlacement placement ) {
+    if ( placement == NumaPlacement::NONE || rel.len == 0 ) {
+        return true;
+    }
+    size_t pageSize = sysconf ( _SC_PAGESIZE );
+    size_t nodes = numaNodes();
+    // mbind works on whole pages, round the relation to page boundaries
+    uintptr_t first = reinterpret_cast<uintptr_t> ( rel.r ) & ~( pageSize - 1 );
+    uintptr_t last = ( reinterpret_cast<uintptr_t> ( rel.r + rel.len ) + pageSize - 1 ) & ~( pageSize - 1 );
+    char* begin = reinterpret_cast<char*> ( first );
+
+    if ( placement == NumaPlacement::INTERLEAVE ) {
+        unsigned long all = ( nodes == MAX_NODES ) ? ~0ul : ( 1ul << nodes ) - 1;
+        return bindRange ( begin, reinterpret_cast<char*> ( last ), MPOL_INTERLEAVE, all );
+    }
+
+    size_t pages = ( last - first ) / pageSize;
+    size_t pagesPerNode = ( pages + nodes - 1 ) / nodes;
+    bool success = true;
+    for ( size_t node = 0; node < nodes; node++ ) {
+        size_t from = std::min ( pages, node * pagesPerNode );
+        size_t to = std::min ( pages, from + pagesPerNode );
+        success &= bindRange ( begin + from * pageSize, begin + to * pageSize, MPOL_BIND, 1ul << node );
+    }
+    return success;
+}
+
+
+std::vector<int> numaNodesOf ( const std::vector<const void*>& addrs ) {
+    std::vector<int> status ( addrs.size(), -1 );
+    if ( addrs.empty() ) {
+        return status;
+    }
+    // move_pages without target nodes only reports the current node of each page
+    if ( syscall ( SYS_move_pages, 0, addrs.size(), addrs.data(), nullptr, status.data(), 0 ) != 0 ) {
+        std::fill ( status.begin(), status.end(), -1 );
+        return status;
+    }
+    for ( auto& node : status ) {
+        node = ( node < 0 ) ? -1 : node;
+    }
+    return status;
+}
@@ -0,0 +1,60 @@
+/**
+ * @file
+ *
+ * NUMA topology, page placement of mapped relations and thread pinning.
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "DBData.h"
+
+
+/**
+  * @brief Placement of the pages of a relation across the NUMA nodes.
+  * INTERLEAVE distributes the pages round robin, CHUNKED places one contiguous range per node.
+  */
+enum class NumaPlacement { NONE, INTERLEAVE, CHUNKED };
+
+
+/**
+  * @brief Number of NUMA nodes of the machine, 1 if the kernel does not expose any.
+  */
+size_t numaNodes ();
+
+
+/**
+  * @brief CPUs belonging to node.
+  */
+std::vector<int> numaNodeCpus ( int node );
+
+
+/**
+  * @brief Pin the calling thread to the CPUs of node.
+  * Returns false if the node has no CPUs or the affinity could not be set.
+  */
+bool numaPinThread ( int node );
+
+
+/**
+  * @brief Node the calling thread is currently running on.
+  */
+int numaCurrentNode ();
+
+
+/**
+  * @brief Bind the pages of rel according to placement and migrate the pages already present.
+  * Returns false if the kernel rejected the policy, e.g., without NUMA support. Pages of the
+  * mapped file shared with other processes may stay where they are.
+  */
+bool numaPlaceRelation ( Relation rel, NumaPlacement placement );
+
+
+/**
+  * @brief Query the node of the page of every address in addrs.
+  * Entries are -1 for pages that are not present or if the query failed.
+  */
+std::vector<int> numaNodesOf ( const std::vector<const void*>& addrs );
@@ -15,10 +15,13 @@
 #include <pthread.h>
 #include <thread>
 #include <cstdlib>
+#include <utility>
+#include <vector>
 
 #include "BaseOperator.h"
 #include "DBData.h"
 
+/* default of RelOperator::batchSize */
 static constexpr size_t BATCH_SIZE = 1024;
 static constexpr size_t BATCH_SIZE_LOG = 10;
 static_assert(BATCH_SIZE == (1 << BATCH_SIZE_LOG));
@@ -94,6 +97,24 @@ public:
     virtual size_t getSize () {
         return tableSize;
     }
+
+    virtual bool fingerprint ( PlanFingerprint& fp );
+
+    /**
+     * @brief Fingerprint of a scan over the first n tuples of the mapped relation at table.
+     */
+    static bool fingerprintTable ( Tuple* table, size_t n, PlanFingerprint& fp );
+
+    /**
+     * @brief The scanned table itself, for operators reading it without materialization.
+     */
+    Relation getTable () {
+        Relation tab;
+        tab.r = table;
+        tab.len = tableSize;
+        tab.capacity = tableSize;
+        return tab;
+    }
     
     virtual void open();
     virtual Tuple* next();
@@ -115,6 +136,16 @@ class SelectionOp : public RelOperator {
 public:
     enum PredicateType { SMALLER, EQUALS, EQUALS_NOT };
 
+    /**
+     * Operator-at-a-time evaluation of stacked selections: MATERIALIZE compacts the qualifying
+     * tuples after every predicate, BITMAP evaluates every predicate into one packed bitmap
+     * and only uses the final bitmap to compact (or aggregate) the input. FUSED lets an
+     * aggregation evaluate the selections below it and aggregate in the same pass over the
+     * table, selections without aggregation are materialized.
+     */
+    enum FilterMode { MATERIALIZE, BITMAP, FUSED };
+    static FilterMode filterMode;
+
 protected:
     SelectionOp::PredicateType type;
     int compareConstant;
@@ -122,18 +153,39 @@ protected:
     /* vector-at-a-time */
     Relation oCol;
 
+    /* operator-at-a-time with bitmaps */
+    uint64_t* bitmap = nullptr;
+    size_t bitmapCapacity = 0;
+
 public:
     SelectionOp( PredicateType type, int compareConstant, RelOperator* child ) : RelOperator ( child ) {
         this->type = type;
         this->compareConstant = compareConstant;
-        this->oCol = allocateRelation ( BATCH_SIZE );
+        this->oCol = allocateRelation ( RelOperator::batchSize );
     }
 
-    virtual ~SelectionOp() {};
+    virtual ~SelectionOp() {
+        free ( this->bitmap );
+    };
     
     virtual size_t getSize () {
         return child->getSize();
     }
+
+    /**
+     * @brief Collect the predicates of this and all directly stacked selections, top-down.
+     * Returns the input of the lowest selection.
+     */
+    RelOperator* collectConjunction ( std::vector<std::pair<PredicateType, int>>& predicates );
+
+    /**
+     * @brief Evaluate this and all directly stacked selections into one bitmap (operator-at-a-time).
+     * Returns the input of the lowest selection, bit i of *outBitmap is set iff tuple i qualifies.
+     * The bitmap is owned by the operator.
+     */
+    Relation getRelationBitmap ( const uint64_t** outBitmap );
+
+    virtual bool fingerprint ( PlanFingerprint& fp );
  
     virtual void open();
     virtual Tuple* next();
@@ -162,6 +214,9 @@ protected:
     /* operator-at-a-time */
     Relation oCol;
 
+    /* operator-at-a-time, filter and aggregate the input in one pass */
+    Tuple aggregateFused ();
+
 public:
     AggregationOp ( ReduceType type, RelOperator* child ) : RelOperator ( child ) {
         this->oCol = allocateRelation ( 1 );
@@ -176,6 +231,8 @@ public:
         return 1;
     }
 
+    virtual bool fingerprint ( PlanFingerprint& fp );
+
     virtual void open();
     virtual Tuple* next();
     virtual void close();
@@ -8,16 +8,75 @@
  * @authors: Jana Giceva <jana.giceva@in.tum.de>, Alexander Beischl <beischl@in.tum.de>
  */
  
+#include <algorithm>
+#include <climits>
+#include <vector>
+
 #include "Operators.h"
 #include "primitives.h"
 
 
+SelectionOp::FilterMode SelectionOp::filterMode = SelectionOp::FilterMode::MATERIALIZE;
+
+
 Relation ScanOp::getRelation() {
     oCol.len = scanLong ( table, oCol.r, this->tableSize );
     return oCol;
 }
 
+RelOperator* SelectionOp::collectConjunction ( std::vector<std::pair<PredicateType, int>>& predicates ) {
+    RelOperator* input = this;
+    SelectionOp* sel;
+    while ( ( sel = dynamic_cast<SelectionOp*> ( input ) ) != nullptr ) {
+        predicates.emplace_back ( sel->type, sel->compareConstant );
+        input = sel->child;
+    }
+    return input;
+}
+
+Relation SelectionOp::getRelationBitmap ( const uint64_t** outBitmap ) {
+    // evaluate the predicates from the bottom to the top of the plan
+    std::vector<std::pair<PredicateType, int>> conjunction;
+    RelOperator* input = collectConjunction ( conjunction );
+
+    Relation in = input->getRelation();
+    size_t words = bitmapWords ( in.len );
+    if ( words > bitmapCapacity ) {
+        free ( this->bitmap );
+        this->bitmap = (uint64_t*) malloc ( sizeof ( uint64_t ) * words );
+        this->bitmapCapacity = words;
+    }
+
+    bool first = true;
+    for ( auto it = conjunction.rbegin(); it != conjunction.rend(); ++it ) {
+        long int val = it->second;
+        switch ( it->first ) {
+            case PredicateType::EQUALS:
+                first ? cmpMask<CMP_EQ, BITMAP_SET> ( in.r, val, bitmap, in.len )
+                      : cmpMask<CMP_EQ, BITMAP_AND> ( in.r, val, bitmap, in.len );
+                break;
+            case PredicateType::EQUALS_NOT:
+                first ? cmpMask<CMP_NE, BITMAP_SET> ( in.r, val, bitmap, in.len )
+                      : cmpMask<CMP_NE, BITMAP_AND> ( in.r, val, bitmap, in.len );
+                break;
+            case PredicateType::SMALLER:
+                first ? cmpMask<CMP_LT, BITMAP_SET> ( in.r, val, bitmap, in.len )
+                      : cmpMask<CMP_LT, BITMAP_AND> ( in.r, val, bitmap, in.len );
+                break;
+        }
+        first = false;
+    }
+    *outBitmap = bitmap;
+    return in;
+}
+
 Relation SelectionOp::getRelation() {
+    if ( filterMode == FilterMode::BITMAP ) {
+        const uint64_t* qualifying;
+        Relation in = getRelationBitmap ( &qualifying );
+        in.len = compactBitmap ( in.r, qualifying, in.r, in.len );
+        return in;
+    }
     Relation in = child->getRelation();
     switch ( this->type ) {
         case PredicateType::EQUALS:
@@ -33,10 +92,76 @@ Relation SelectionOp::getRelation() {
     return in;
 }
 
+Tuple AggregationOp::aggregateFused() {
+    // split the conjunction below into one bound for <, one value for == and the set for <>
+    std::vector<std::pair<SelectionOp::PredicateType, int>> conjunction;
+    SelectionOp* sel = dynamic_cast<SelectionOp*> ( child );
+    RelOperator* input = ( sel != nullptr ) ? sel->collectConjunction ( conjunction ) : child;
+    bool hasLess = false, hasEquals = false, empty = false;
+    long int bound = LONG_MAX, equals = 0;
+    std::vector<long int> notIn;
+    for ( auto& predicate : conjunction ) {
+        switch ( predicate.first ) {
+            case SelectionOp::PredicateType::SMALLER:
+                hasLess = true;
+                bound = std::min ( bound, (long int) predicate.second );
+                break;
+            case SelectionOp::PredicateType::EQUALS:
+                empty |= ( hasEquals && equals != predicate.second );
+                hasEquals = true;
+                equals = predicate.second;
+                break;
+            case SelectionOp::PredicateType::EQUALS_NOT:
+                notIn.push_back ( predicate.second );
+                break;
+        }
+    }
+
+    // read a scanned table in place instead of materializing it first
+    ScanOp* scan = dynamic_cast<ScanOp*> ( input );
+    Relation in = ( scan != nullptr ) ? scan->getTable() : input->getRelation();
+    bool sum = ( this->type == AggregationOp::ReduceType::SUM );
+
+    if ( hasEquals ) {
+        // all qualifying tuples are equal, check the other predicates once
+        for ( long int val : notIn ) {
+            empty |= ( equals == val );
+        }
+        empty |= ( hasLess && equals >= bound );
+        if ( empty ) {
+            return 0;
+        }
+        return sum ? sumWhereEquals ( in.r, equals, in.len ) : countWhereEquals ( in.r, equals, in.len );
+    }
+    if ( hasLess ) {
+        return sum ? sumWhereLessNotIn ( in.r, bound, notIn.data(), notIn.size(), in.len )
+                   : countWhereLessNotIn ( in.r, bound, notIn.data(), notIn.size(), in.len );
+    }
+    return sum ? sumWhereNotIn ( in.r, notIn.data(), notIn.size(), in.len )
+               : countWhereNotIn ( in.r, notIn.data(), notIn.size(), in.len );
+}
+
 Relation AggregationOp::getRelation() {
     oCol.r[0] = 0;
-    Relation in = child->getRelation();
     oCol.len = 1;
+    if ( SelectionOp::filterMode == SelectionOp::FilterMode::FUSED ) {
+        oCol.r[0] = aggregateFused();
+        return oCol;
+    }
+    SelectionOp* sel = dynamic_cast<SelectionOp*> ( child );
+    if ( SelectionOp::filterMode == SelectionOp::FilterMode::BITMAP && sel != nullptr ) {
+        // aggregate the qualifying tuples directly, without compacting them
+        const uint64_t* qualifying;
+        Relation in = sel->getRelationBitmap ( &qualifying );
+        if ( this->type == AggregationOp::ReduceType::COUNT ) {
+            oCol.r[0] = aggCountBitmap ( qualifying, in.len );
+        }
+        if ( this->type == AggregationOp::ReduceType::SUM ) {
+            oCol.r[0] = aggSumBitmap ( in.r, qualifying, in.len );
+        }
+        return oCol;
+    }
+    Relation in = child->getRelation();
     if ( this->type == AggregationOp::ReduceType::COUNT ) {
         oCol.r[0] = aggCount ( in.r, in.len );
     }
@@ -0,0 +1,52 @@
+/**
+ * @file
+ *
+ * Canonical fingerprints of query plans, independent of the processing model.
+ *
+ */
+
+#include <algorithm>
+#include <utility>
+
+#include "Operators.h"
+
+
+bool ScanOp::fingerprintTable ( Tuple* table, size_t n, PlanFingerprint& fp ) {
+    DataSource source;
+    if ( !getDataSource ( table, &source ) ) {
+        return false;
+    }
+    fp.key += "SCAN(" + source.filepath + "@" + std::to_string ( source.version ) + "," + std::to_string ( n ) + ")";
+    fp.sources.push_back ( source );
+    return true;
+}
+
+bool ScanOp::fingerprint ( PlanFingerprint& fp ) {
+    return fingerprintTable ( table, tableSize, fp );
+}
+
+bool SelectionOp::fingerprint ( PlanFingerprint& fp ) {
+    // the order of the predicates of a conjunction does not matter
+    std::vector<std::pair<PredicateType, int>> predicates;
+    RelOperator* input = collectConjunction ( predicates );
+    std::sort ( predicates.begin(), predicates.end() );
+    predicates.erase ( std::unique ( predicates.begin(), predicates.end() ), predicates.end() );
+
+    static const char* ops[] = { "<", "==", "<>" };
+    fp.key += "SELECT(";
+    for ( size_t i = 0; i < predicates.size(); i++ ) {
+        fp.key += ( i > 0 ? " AND x" : "x" );
+        fp.key += ops[predicates[i].first] + std::to_string ( predicates[i].second );
+    }
+    fp.key += ",";
+    bool identifiable = input->fingerprint ( fp );
+    fp.key += ")";
+    return identifiable;
+}
+
+bool AggregationOp::fingerprint ( PlanFingerprint& fp ) {
+    fp.key += ( this->type == AggregationOp::ReduceType::COUNT ) ? "COUNT(" : "SUM(";
+    bool identifiable = child->fingerprint ( fp );
+    fp.key += ")";
+    return identifiable;
+}
@@ -11,6 +11,8 @@
 #include "Operators.h"
 #include "primitives.h"
 
+size_t RelOperator::batchSize = BATCH_SIZE;
+
 void ScanOp::openVec() {
     this->cursor = 0;
     this->vector_finish = false;
@@ -24,8 +26,8 @@ Relation& ScanOp::nextVec() {
     oCol.len = 0;
     return oCol;
   }
-  oCol.len = scanLong ( table + cursor, oCol.r, (cursor + BATCH_SIZE <= this->tableSize) ?
-                                                 BATCH_SIZE :
+  oCol.len = scanLong ( table + cursor, oCol.r, (cursor + batchSize <= this->tableSize) ?
+                                                 batchSize :
                                                 (this->vector_finish = true, this->tableSize - cursor));
   cursor += oCol.len;
   return oCol;
@@ -37,7 +39,7 @@ void ScanOp::closeVec() {
 }
 
 void SelectionOp::openVec() {
-  child->open();
+  child->openVec();
 }
 
 Relation& SelectionOp::nextVec() {
@@ -62,8 +64,9 @@ Relation& SelectionOp::nextVec() {
           break;
       }
 
-      if (out_counter == BATCH_SIZE) {
-        if (in_counter < in.len) in.start_offset = in_counter;
+      if (out_counter == oCol.capacity) {
+        // Resume at in_counter next time, or fetch a new child vector if this one is used up
+        in.start_offset = (in_counter < in.len) ? in_counter : 0;
         oCol.len = out_counter;
         return oCol;
       }
@@ -76,11 +79,11 @@ Relation& SelectionOp::nextVec() {
 }
 
 void SelectionOp::closeVec() {
-  child->close();
+  child->closeVec();
 }
 
 void AggregationOp::openVec() {
-  child->open();
+  child->openVec();
 //  countTuple = 0;
 //  this->hasMoreTuples = true;
   oCol.r[0] = 0;
@@ -109,5 +112,5 @@ Relation& AggregationOp::nextVec() {
 }
 
 void AggregationOp::closeVec() {
-  child->close();
+  child->closeVec();
 }
\ No newline at end of file
@@ -0,0 +1,64 @@
+/**
+ * @file
+ *
+ * Query plans of the benchmark.
+ *
+ */
+
+#include "Queries.h"
+
+
+RelOperator* scanLeaf ( Relation relation, SharedScan* shared, MorselQueue* morsels, int node ) {
+    if ( morsels != nullptr ) {
+        return new MorselScanOp ( morsels, node );
+    }
+    if ( shared != nullptr ) {
+        return new SharedScanOp ( shared );
+    }
+    return new ScanOp ( relation.r, relation.len );
+}
+
+
+std::array<RelOperator*, 4> buildQuerys ( Relation relation, SharedScan* shared, MorselQueue* morsels, int node ) {
+    std::array<RelOperator*, 4> querys{};
+
+    // Query0: SELECT SUM(x) FROM rel WHERE x <> 11 AND x <> 42 AND x <> 99　AND x <> 30 AND x <> 77;
+    querys[0] = new AggregationOp ( AggregationOp::SUM,
+        new SelectionOp ( SelectionOp::PredicateType::EQUALS_NOT, 77,
+            new SelectionOp ( SelectionOp::PredicateType::EQUALS_NOT, 30,
+                new SelectionOp ( SelectionOp::PredicateType::EQUALS_NOT, 99,
+                    new SelectionOp ( SelectionOp::PredicateType::EQUALS_NOT, 42,
+                        new SelectionOp ( SelectionOp::PredicateType::EQUALS_NOT, 11,
+                            scanLeaf ( relation, shared, morsels, node )
+                        )
+                    )
+                )
+            )
+        )
+    );
+
+    // Query1: SELECT x FROM rel WHERE x == 11;
+    querys[1] = new SelectionOp ( SelectionOp::PredicateType::EQUALS, 11,
+        scanLeaf ( relation, shared, morsels, node )
+    );
+
+    // Query2: SELECT SUM(x) FROM rel WHERE x <> 12 AND x <> 11 AND x <> 42 AND x <> 43;
+    querys[2] = new AggregationOp ( AggregationOp::SUM,
+        new SelectionOp ( SelectionOp::PredicateType::EQUALS_NOT, 43,
+            new SelectionOp ( SelectionOp::PredicateType::EQUALS_NOT, 42,
+                new SelectionOp ( SelectionOp::PredicateType::EQUALS_NOT, 11,
+                    new SelectionOp ( SelectionOp::PredicateType::EQUALS_NOT, 12,
+                        scanLeaf ( relation, shared, morsels, node )
+                    )
+                )
+            )
+        )
+    );
+
+    // Query3: SELECT sum(x) FROM rel;
+    querys[3] = new AggregationOp ( AggregationOp::SUM,
+        scanLeaf ( relation, shared, morsels, node )
+    );
+
+    return querys;
+}
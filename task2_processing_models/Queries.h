@@ -0,0 +1,29 @@
+/**
+ * @file
+ *
+ * Query plans of the benchmark.
+ *
+ */
+
+#pragma once
+
+#include <array>
+
+#include "DBData.h"
+#include "Operators.h"
+#include "MorselScan.h"
+#include "SharedScan.h"
+
+
+/**
+  * @brief Leaf of a query plan, either a private scan, a consumer of the shared scan or
+  * a worker on node of the parallel morsel scan
+  */
+RelOperator* scanLeaf ( Relation relation, SharedScan* shared, MorselQueue* morsels = nullptr, int node = 0 );
+
+
+/**
+  * @brief Build the query plans of the benchmark on top of the given scan leaves
+  */
+std::array<RelOperator*, 4> buildQuerys ( Relation relation, SharedScan* shared = nullptr,
+                                          MorselQueue* morsels = nullptr, int node = 0 );
@@ -0,0 +1,101 @@
+/**
+ * @file
+ *
+ * Implementation of the query result cache.
+ *
+ */
+
+#include <cstring>
+
+#include "ResultCache.h"
+
+
+void ResultCache::erase ( std::list<Entry>::iterator it ) {
+    used -= entrySize ( it->result );
+    freeRelation ( it->result );
+    index.erase ( it->key );
+    entries.erase ( it );
+}
+
+void ResultCache::invalidateStale () {
+    uint64_t epoch = getDataEpoch();
+    if ( epoch == checkedEpoch ) {
+        return;
+    }
+    checkedEpoch = epoch;
+    for ( auto it = entries.begin(); it != entries.end(); ) {
+        bool stale = false;
+        for ( auto& source : it->sources ) {
+            stale |= ( getDataVersion ( source.filepath ) != source.version );
+        }
+        auto next = std::next ( it );
+        if ( stale ) {
+            erase ( it );
+            invalidations++;
+        }
+        it = next;
+    }
+}
+
+Relation ResultCache::execute ( RelOperator* root ) {
+    PlanFingerprint fp;
+    if ( !root->fingerprint ( fp ) ) {
+        uncacheable++;
+        return root->getRelation();
+    }
+    Relation result;
+    if ( lookup ( fp, &result ) ) {
+        return result;
+    }
+    result = root->getRelation();
+    insert ( fp, result );
+    return result;
+}
+
+bool ResultCache::lookup ( const PlanFingerprint& fp, Relation* out ) {
+    invalidateStale();
+    auto it = index.find ( fp.key );
+    if ( it == index.end() ) {
+        misses++;
+        return false;
+    }
+    hits++;
+    entries.splice ( entries.begin(), entries, it->second );
+    *out = it->second->result;
+    return true;
+}
+
+void ResultCache::insert ( const PlanFingerprint& fp, Relation result ) {
+    invalidateStale();
+    size_t size = entrySize ( result );
+    if ( size > budget ) {
+        return;
+    }
+    auto it = index.find ( fp.key );
+    if ( it != index.end() ) {
+        erase ( it->second );
+    }
+    while ( used + size > budget ) {
+        erase ( std::prev ( entries.end() ) );
+        evictions++;
+    }
+
+    Relation copy = allocateRelation ( result.len > 0 ? result.len : 1 );
+    memcpy ( copy.r, result.r, size );
+    copy.len = result.len;
+    entries.push_front ( Entry { fp.key, fp.sources, copy } );
+    index[fp.key] = entries.begin();
+    used += size;
+}
+
+void ResultCache::clear () {
+    while ( !entries.empty() ) {
+        erase ( entries.begin() );
+    }
+}
+
+void ResultCache::printStats ( std::ostream& out ) {
+    out << "hits, misses, uncacheable, evictions, invalidations, entries, bytes, hitRate" << std::endl;
+    out << hits << ", " << misses << ", " << uncacheable << ", " << evictions << ", " << invalidations << ", "
+        << entries.size() << ", " << used << ", " << getHitRate() << std::endl;
+}
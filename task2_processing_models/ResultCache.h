@@ -0,0 +1,100 @@
+/**
+ * @file
+ *
+ * Cache for query results keyed by the fingerprint of the query plan.
+ *
+ */
+
+#pragma once
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <iostream>
+
+#include "BaseOperator.h"
+#include "DBData.h"
+
+/**
+ * @brief LRU cache of query results with a memory budget.
+ * Results are identified by the PlanFingerprint of their plan. Entries of which an input file
+ * was rewritten since they were cached are dropped, as soon as the cache notices the change.
+ * Results larger than the budget are not cached.
+ */
+class ResultCache {
+protected:
+    struct Entry {
+        std::string key;
+        std::vector<DataSource> sources;
+        Relation result;
+    };
+
+    size_t budget;
+    size_t used = 0;
+
+    /* most recently used entry at the front */
+    std::list<Entry> entries;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+
+    /* data epoch at the last check for rewritten files */
+    uint64_t checkedEpoch;
+
+    /* statistics */
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t uncacheable = 0;
+    size_t evictions = 0;
+    size_t invalidations = 0;
+
+    static size_t entrySize ( const Relation& result ) {
+        return sizeof ( Tuple ) * result.len;
+    }
+
+    /* drop entry and free its result */
+    void erase ( std::list<Entry>::iterator it );
+
+    /* drop all entries that read a file which changed since they were cached */
+    void invalidateStale ();
+
+public:
+    ResultCache ( size_t budgetBytes ) : budget ( budgetBytes ), checkedEpoch ( getDataEpoch() ) {}
+
+    ~ResultCache() {
+        clear();
+    }
+
+    ResultCache ( const ResultCache& ) = delete;
+    ResultCache& operator= ( const ResultCache& ) = delete;
+
+    /**
+     * @brief Return the result of the plan rooted at root.
+     * On a hit the cached relation is returned, otherwise the plan is executed operator-at-a-time
+     * and its result is cached. The returned relation is owned by the cache or the plan and stays
+     * valid until the next call.
+     */
+    Relation execute ( RelOperator* root );
+
+    /**
+     * @brief Lookup the result for fp, returns false on a miss.
+     */
+    bool lookup ( const PlanFingerprint& fp, Relation* out );
+
+    /**
+     * @brief Store a copy of result for fp, evicting least recently used entries if needed.
+     */
+    void insert ( const PlanFingerprint& fp, Relation result );
+
+    /**
+     * @brief Drop all entries.
+     */
+    void clear ();
+
+    double getHitRate () {
+        return ( hits + misses == 0 ) ? 0.0 : static_cast<double> ( hits ) / ( hits + misses );
+    }
+
+    /**
+     * @brief Print hit rate and the other counters.
+     */
+    void printStats ( std::ostream& out );
+};
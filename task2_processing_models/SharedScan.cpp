@@ -0,0 +1,164 @@
+/**
+ * @file
+ *
+ * Implementation of the shared scan cursor and the shared scan operator for all processing models.
+ *
+ */
+
+#include <cassert>
+
+#include "SharedScan.h"
+#include "primitives.h"
+
+
+SharedScan::SharedScan ( Tuple* tab, size_t n ) {
+    this->table = tab;
+    this->tableSize = n;
+    this->chunkSize = SHARED_SCAN_BATCHES * RelOperator::batchSize;
+    this->numChunks = ( n + chunkSize - 1 ) / chunkSize;
+}
+
+void SharedScan::advance () {
+    position = ( position + 1 ) % numChunks;
+    if ( consumers == 0 ) {
+        // idle, the next consumer continues at this position
+        pending = 0;
+        return;
+    }
+    epoch++;
+    pending = consumers;
+    published.notify_all();
+}
+
+uint64_t SharedScan::attach () {
+    std::lock_guard<std::mutex> lock ( mutex );
+    if ( consumers++ == 0 ) {
+        // the scan was idle, publish the current position for the new consumer
+        epoch++;
+        pending = 1;
+        published.notify_all();
+        return epoch;
+    }
+    // join mid-scan with the next chunk, the current one may already be in use
+    return epoch + 1;
+}
+
+Tuple* SharedScan::acquire ( uint64_t epochToRead, size_t* len ) {
+    std::unique_lock<std::mutex> lock ( mutex );
+    published.wait ( lock, [&] { return epoch >= epochToRead; } );
+    assert ( epoch == epochToRead );
+    size_t start = position * chunkSize;
+    *len = ( start + chunkSize <= tableSize ) ? chunkSize : tableSize - start;
+    return table + start;
+}
+
+void SharedScan::release ( bool lastChunk ) {
+    std::lock_guard<std::mutex> lock ( mutex );
+    assert ( pending > 0 );
+    if ( lastChunk ) {
+        consumers--;
+    }
+    if ( --pending == 0 ) {
+        advance();
+    }
+}
+
+void SharedScan::detach ( uint64_t nextEpoch ) {
+    std::unique_lock<std::mutex> lock ( mutex );
+    if ( nextEpoch == epoch ) {
+        // the consumer still blocks the published chunk
+        lock.unlock();
+        release ( true );
+        return;
+    }
+    consumers--;
+}
+
+
+void SharedScanOp::attach () {
+    if ( attached ) {
+        detach();
+    }
+    nextEpoch = scan->attach();
+    remainingChunks = scan->getNumChunks();
+    attached = true;
+    oCol.len = 0;
+    oCol.start_offset = 0;
+    cursor = 0;
+}
+
+size_t SharedScanOp::fetchChunk ( Tuple* out ) {
+    if ( !attached ) {
+        return 0;
+    }
+    size_t len;
+    Tuple* chunk = scan->acquire ( nextEpoch, &len );
+    scanLong ( chunk, out, len );
+    bool lastChunk = ( --remainingChunks == 0 );
+    scan->release ( lastChunk );
+    attached = !lastChunk;
+    nextEpoch++;
+    return len;
+}
+
+void SharedScanOp::detach () {
+    if ( attached ) {
+        scan->detach ( nextEpoch );
+        attached = false;
+    }
+}
+
+
+void SharedScanOp::open() {
+    attach();
+}
+
+Tuple* SharedScanOp::next() {
+    if ( cursor >= oCol.len ) {
+        oCol.len = fetchChunk ( oCol.r );
+        cursor = 0;
+        if ( oCol.len == 0 ) {
+            return nullptr;
+        }
+    }
+    return &oCol.r[cursor++];
+}
+
+void SharedScanOp::close() {
+    detach();
+}
+
+
+Relation SharedScanOp::getRelation() {
+    attach();
+    size_t len = 0;
+    size_t n;
+    while ( ( n = fetchChunk ( oCol.r + len ) ) != 0 ) {
+        len += n;
+    }
+    oCol.len = len;
+    return oCol;
+}
+
+
+void SharedScanOp::openVec() {
+    attach();
+}
+
+Relation& SharedScanOp::nextVec() {
+    if ( this->oCol.start_offset != 0 ) {
+        // Return the rest cached elements
+        return oCol;
+    }
+    oCol.len = fetchChunk ( oCol.r );
+    return oCol;
+}
+
+void SharedScanOp::closeVec() {
+    detach();
+}
+
+bool SharedScanOp::fingerprint ( PlanFingerprint& fp ) {
+    // same tuples as a private scan, only their order depends on the position of the shared cursor
+    return ScanOp::fingerprintTable ( scan->getTable(), scan->getSize(), fp );
+}
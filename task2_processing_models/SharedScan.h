@@ -0,0 +1,145 @@
+/**
+ * @file
+ *
+ * Shared (cooperative) scan of one relation for many concurrently running query plans.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+
+#include "BaseOperator.h"
+#include "DBData.h"
+#include "Operators.h"
+
+/* Number of vectors (RelOperator::batchSize tuples each) handed out per step of the shared cursor. Large
+ * enough to amortize the synchronization between consumers, small enough to stay cache resident until
+ * all of them read it. */
+static constexpr size_t SHARED_SCAN_BATCHES = 16;
+
+/**
+ * @brief Circular cursor over a table that is shared by all attached consumers.
+ * The cursor publishes one chunk of the table at a time and only advances after every attached
+ * consumer has read the chunk. Thus, the table is fetched from memory once per pass, independent
+ * of the number of queries. Consumers may attach at any time: they start with the next published
+ * chunk, wrap around at the end of the table and detach after they have seen every chunk once.
+ */
+class SharedScan {
+protected:
+    Tuple* table;
+    size_t tableSize;
+    size_t chunkSize;
+    size_t numChunks;
+
+    std::mutex mutex;
+    std::condition_variable published;
+
+    /* sequence number of the currently published chunk */
+    uint64_t epoch = 0;
+    /* chunk index of the currently published chunk */
+    size_t position = 0;
+    /* attached consumers */
+    size_t consumers = 0;
+    /* consumers that did not release the current chunk yet */
+    size_t pending = 0;
+
+    /* publish the next chunk, requires the lock */
+    void advance ();
+
+public:
+    /* chunks of SHARED_SCAN_BATCHES vectors of the current RelOperator::batchSize */
+    SharedScan ( Tuple* tab, size_t n );
+
+    size_t getSize () {
+        return tableSize;
+    }
+
+    Tuple* getTable () {
+        return table;
+    }
+
+    size_t getNumChunks () {
+        return numChunks;
+    }
+
+    /**
+     * @brief Register a consumer and return the epoch of the first chunk it will read.
+     */
+    uint64_t attach ();
+
+    /**
+     * @brief Wait until the chunk of the given epoch is published.
+     * Returns a pointer to the chunk and writes its length to len.
+     */
+    Tuple* acquire ( uint64_t epochToRead, size_t* len );
+
+    /**
+     * @brief Signal that the consumer is done with the current chunk.
+     * The consumer leaves the scan, if lastChunk is set.
+     */
+    void release ( bool lastChunk );
+
+    /**
+     * @brief Deregister a consumer before it has seen the whole table.
+     * nextEpoch is the epoch the consumer would have read next.
+     */
+    void detach ( uint64_t nextEpoch );
+};
+
+
+/**
+ * @brief Leaf operator that reads its input from a SharedScan instead of the table.
+ * The operator attaches to the shared cursor on open and receives the whole table in the
+ * circular order of the shared scan. Plans using it have to run concurrently, e.g., one
+ * thread per query, since all consumers of a SharedScan advance in lockstep.
+ */
+class SharedScanOp : public RelOperator {
+protected:
+    SharedScan* scan;
+    bool attached = false;
+    uint64_t nextEpoch = 0;
+    size_t remainingChunks = 0;
+
+    /* volcano */
+    size_t cursor = 0;
+    /* all models, holds the current chunk or the full relation for operator-at-a-time */
+    Relation oCol;
+
+    /* attach to the shared scan */
+    void attach ();
+
+    /* copy the next chunk of the shared scan to out and return its length, 0 if done */
+    size_t fetchChunk ( Tuple* out );
+
+    /* leave the shared scan early */
+    void detach ();
+
+public:
+    SharedScanOp ( SharedScan* scan ) : RelOperator ( nullptr ) {
+        this->scan = scan;
+        this->oCol = allocateRelation ( scan->getSize() );
+    }
+
+    virtual ~SharedScanOp() {
+        freeRelation ( this->oCol );
+    }
+
+    virtual size_t getSize () {
+        return scan->getSize();
+    }
+
+    virtual bool fingerprint ( PlanFingerprint& fp );
+
+    virtual void open();
+    virtual Tuple* next();
+    virtual void close();
+
+    virtual Relation getRelation();
+
+    virtual void openVec();
+    virtual Relation& nextVec();
+    virtual void closeVec();
+};
@@ -0,0 +1,16 @@
+/**
+ * @file
+ *
+ * Wall clock timer for query executions.
+ *
+ */
+
+#pragma once
+
+#include "../common/CycleTimer.h"
+
+
+/**
+  * @brief Class to time executions, get() returns milliseconds measured with the TSC.
+  */
+using Timer = CycleTimer;
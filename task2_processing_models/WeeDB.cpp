@@ -13,10 +13,18 @@
 #include <iomanip>
 #include <chrono>
 #include <cassert>
+#include <array>
+#include <thread>
+#include <vector>
 #include <unistd.h>
 
 #include "DBData.h"
 #include "Operators.h"
+#include "SharedScan.h"
+#include "AggregateView.h"
+#include "ResultCache.h"
+#include "Queries.h"
+#include "Timer.h"
 #include "PerfEvent.hpp"
 
 #ifndef RELATION_LEN
@@ -26,45 +34,31 @@
 
 
 /**
-  * @brief Class to time executions.
+  * @brief Output header line for csv
   */
-class Timer {
-public:
-    std::chrono::time_point<std::chrono::high_resolution_clock> start;
-
-    /**
-      * @brief Take timestamp at a position in the code
-      */
-    Timer() {
-        start = std::chrono::high_resolution_clock::now();
-    }
-
-    /**
-      * @brief Get milliseconds from timestamp to now
-      */
-    double get() {
-        auto end = std::chrono::high_resolution_clock::now();
-        std::chrono::duration<double> diff = end - start;
-        return diff.count() * 1000;
-    }
-};
+void csvHeader () {
+    std::cout << std::endl << "RELATION_LEN, tVolcano, tOperatorAtATime, tVectorAtATime, tBitmap, tFused" << std::endl;
+}
 
 
 /**
-  * @brief Output header line for csv
+  * @brief Output timings of different execution models as csv line
   */
-void csvHeader () {
-    std::cout << std::endl << "RELATION_LEN, tVolcano, tOperatorAtATime, tVectorAtATime" << std::endl;
+void csvStats ( double tVolc, double tOp, double tVec, double tBitmap, double tFused ) {
+    std::cout << std::fixed;
+    std::cout << std::setprecision(1);
+    std::cout <<  RELATION_LEN << ", " << tVolc << ", " << tOp << ", " << tVec << ", " << tBitmap << ", " << tFused << std::endl;
 }
 
 
 /**
-  * @brief Output timings of different execution models as csv line
+  * @brief Output timings of concurrent query execution with and without scan sharing as csv
   */
-void csvStats ( double tVolc, double tOp, double tVec ) {
+void csvSharedStats ( double tIndependent, double tShared ) {
+    std::cout << std::endl << "RELATION_LEN, tIndependent, tShared" << std::endl;
     std::cout << std::fixed;
     std::cout << std::setprecision(1);
-    std::cout <<  RELATION_LEN << ", " << tVolc << ", " << tOp << ", " << tVec << std::endl;
+    std::cout <<  RELATION_LEN << ", " << tIndependent << ", " << tShared << std::endl;
 }
 
 
@@ -117,6 +111,25 @@ double execOperatorAtATime ( RelOperator* root ) {
     return tOp.get();
 }
 
+/**
+  * @brief Execute query plan given by root with Operator-at-a-time and the given filter mode
+  */
+double execFilterMode ( RelOperator* root, SelectionOp::FilterMode mode, const char* name ) {
+    SelectionOp::filterMode = mode;
+    PerfEvent e;
+    Timer tMode = Timer();
+    e.startCounters();
+    Relation resultRelation = root->getRelation();
+    e.stopCounters();
+    std::cout << name << " (Operator-at-a-time): ";
+    printRelation ( resultRelation );
+    e.printReport(std::cout, RELATION_LEN); // use n as scale factor
+    std::cout << std::endl;
+    double t = tMode.get();
+    SelectionOp::filterMode = SelectionOp::FilterMode::MATERIALIZE;
+    return t;
+}
+
 /**
   * @brief Execute query plan given by root with Vectorization (Vector-at-a-time)
   */
@@ -136,6 +149,132 @@ double execVectorization ( RelOperator* root ) {
 }
 
 
+/**
+  * @brief Execute all query plans concurrently with Vectorization, one thread per query
+  */
+template <size_t N>
+double execConcurrent ( std::array<RelOperator*, N>& roots, const char* name ) {
+    PerfEvent e;
+    Timer tConc = Timer();
+    e.startCounters();
+    std::vector<Relation> results;
+    std::vector<std::thread> threads;
+    for ( auto root : roots ) {
+        results.push_back ( allocateRelation ( root->getSize() ) );
+    }
+    for ( size_t q = 0; q < N; q++ ) {
+        threads.emplace_back ( PullDriver::vectorization, roots[q], &results[q] );
+    }
+    for ( auto& t : threads ) {
+        t.join();
+    }
+    e.stopCounters();
+    std::cout << name << ":" << std::endl;
+    for ( size_t q = 0; q < N; q++ ) {
+        std::cout << "Query" << q << " ";
+        printRelation ( results[q], results[q].len > 1 );
+        freeRelation ( results[q] );
+    }
+    e.printReport(std::cout, RELATION_LEN); // use n as scale factor
+    std::cout << std::endl;
+    return tConc.get();
+}
+
+
+/**
+  * @brief Maintain the aggregates of Query0-3 as views over an append-only copy of the relation.
+  * After an initial refresh, small batches are appended to the relation and the views are refreshed
+  * incrementally. The view results are checked against recomputing the query with operator-at-a-time.
+  */
+void execIncremental ( const char* appendFile, size_t appendLen, size_t rounds ) {
+    Relation rel;
+    genData ( &rel, appendFile, RELATION_LEN );
+
+    AggregateViews views;
+    std::array<AggregateView*, 4> querys{};
+    // Query0: SELECT SUM(x) FROM rel WHERE x <> 11 AND x <> 42 AND x <> 99 AND x <> 30 AND x <> 77;
+    querys[0] = views.registerView ( AggregationOp::SUM );
+    for ( int c : { 11, 42, 99, 30, 77 } ) {
+        querys[0]->addPredicate ( SelectionOp::PredicateType::EQUALS_NOT, c );
+    }
+    // Query1 (as aggregate): SELECT COUNT(x) FROM rel WHERE x == 11;
+    querys[1] = views.registerView ( AggregationOp::COUNT );
+    querys[1]->addPredicate ( SelectionOp::PredicateType::EQUALS, 11 );
+    // Query2: SELECT SUM(x) FROM rel WHERE x <> 12 AND x <> 11 AND x <> 42 AND x <> 43;
+    querys[2] = views.registerView ( AggregationOp::SUM );
+    for ( int c : { 12, 11, 42, 43 } ) {
+        querys[2]->addPredicate ( SelectionOp::PredicateType::EQUALS_NOT, c );
+    }
+    // Query3: SELECT sum(x) FROM rel;
+    querys[3] = views.registerView ( AggregationOp::SUM );
+
+    Timer tInit = Timer();
+    views.refresh ( rel );
+    std::cout << "Initial refresh of " << rel.len << " tuples: " << tInit.get() << " ms" << std::endl;
+
+    std::cout << std::endl << "RELATION_LEN, tRefresh (us), tRecompute (ms)" << std::endl;
+    for ( size_t round = 0; round < rounds; round++ ) {
+        appendData ( &rel, appendFile, appendLen );
+
+        Timer tRefresh = Timer();
+        views.refresh ( rel );
+        double refreshTime = tRefresh.get() * 1000;
+
+        // recompute from scratch for comparison
+        std::array<RelOperator*, 4> plans = buildQuerys ( rel );
+        Timer tRecompute = Timer();
+        for ( size_t q = 0; q < plans.size(); q++ ) {
+            Relation result = plans[q]->getRelation();
+            Tuple expected = ( q == 1 ) ? (Tuple) result.len : result.r[0];
+            if ( expected != querys[q]->get() ) {
+                std::cout << "View of Query" << q << " is " << querys[q]->get() << ", expected " << expected << std::endl;
+            }
+        }
+        double recomputeTime = tRecompute.get();
+        for ( auto plan : plans ) {
+            plan->deletePlan();
+        }
+
+        std::cout << std::fixed << std::setprecision(1);
+        std::cout << rel.len << ", " << refreshTime << ", " << recomputeTime << std::endl;
+    }
+
+    dropData ( &rel, appendFile );
+}
+
+
+/**
+  * @brief Run the queries repeatedly through a result cache, the way dashboards issue them.
+  * Halfway through, the relation file is regenerated, which invalidates all cached results.
+  */
+void execCached ( Relation* relation, const char* dbFile, size_t rounds ) {
+    ResultCache cache ( sizeof ( Tuple ) * RELATION_LEN );
+
+    std::cout << std::endl << "round, query, tuples, first, tCached (ms)" << std::endl;
+    for ( size_t round = 0; round < rounds; round++ ) {
+        if ( round == rounds / 2 ) {
+            std::cout << "Regenerating data.." << std::endl;
+            dropData ( relation, dbFile );
+            genData ( relation, dbFile, RELATION_LEN );
+        }
+        std::array<RelOperator*, 4> querys = buildQuerys ( *relation );
+        for ( size_t q = 0; q < querys.size(); q++ ) {
+            Timer tCached = Timer();
+            Relation result = cache.execute ( querys[q] );
+            double cachedTime = tCached.get();
+            std::cout << std::fixed << std::setprecision(4);
+            std::cout << round << ", " << q << ", " << result.len << ", " << ( result.len > 0 ? result.r[0] : 0 )
+                      << ", " << cachedTime << std::endl;
+        }
+        for ( auto q : querys ) {
+            q->deletePlan();
+        }
+    }
+    std::cout << std::endl;
+    cache.printStats ( std::cout );
+}
+
+
 /**
   * @brief Parse arguments, generate/read relation, build query plan, and execute.
     The different execution models are selected by arguments or by default we execute all.
@@ -143,7 +282,7 @@ double execVectorization ( RelOperator* root ) {
 int main ( int argc, char* argv[] ) {
 
     // parse arguments
-    bool doVol=false, doOp=false, doVec=false;
+    bool doVol=false, doOp=false, doVec=false, doBitmap=false, doFused=false, doShared=false, doIncr=false, doCache=false;
     std::string args;
     for (int i = 1; i < argc - 1; ++i) {
         args = args.append ( argv[i] );
@@ -152,8 +291,13 @@ int main ( int argc, char* argv[] ) {
     if ( args.find ( "vol" ) != std::string::npos ) doVol = true;
     if ( args.find ( "op" ) != std::string::npos ) doOp = true;
     if ( args.find ( "vec" ) != std::string::npos ) doVec = true;
-    if ( ! ( doVol || doOp || doVec) ) {
-          doVol = true; doOp = true; doVec = true;
+    if ( args.find ( "bm" ) != std::string::npos ) doBitmap = true;
+    if ( args.find ( "fused" ) != std::string::npos ) doFused = true;
+    if ( args.find ( "shared" ) != std::string::npos ) doShared = true;
+    if ( args.find ( "incr" ) != std::string::npos ) doIncr = true;
+    if ( args.find ( "cache" ) != std::string::npos ) doCache = true;
+    if ( ! ( doVol || doOp || doVec || doBitmap || doFused || doShared || doIncr || doCache ) ) {
+          doVol = true; doOp = true; doVec = true; doBitmap = true; doFused = true;
       }
 
     int query = argv[argc - 1][0] - '0';
@@ -167,56 +311,49 @@ int main ( int argc, char* argv[] ) {
         genData ( &relation, dbFile, RELATION_LEN );
     }
 
-    std::array<RelOperator*, 4> querys{};
-
-
     // build plan
-    // Query0: SELECT SUM(x) FROM rel WHERE x <> 11 AND x <> 42 AND x <> 99　AND x <> 30 AND x <> 77;
-    querys[0] = new AggregationOp ( AggregationOp::SUM,
-        new SelectionOp ( SelectionOp::PredicateType::EQUALS_NOT, 77,
-            new SelectionOp ( SelectionOp::PredicateType::EQUALS_NOT, 30,
-                new SelectionOp ( SelectionOp::PredicateType::EQUALS_NOT, 99,
-                    new SelectionOp ( SelectionOp::PredicateType::EQUALS_NOT, 42,
-                        new SelectionOp ( SelectionOp::PredicateType::EQUALS_NOT, 11,
-                            new ScanOp ( relation.r, RELATION_LEN )
-                        )
-                    )
-                )
-            )
-        )
-    );
-
-    // Query1: SELECT x FROM rel WHERE x == 11;
-    querys[1] = new SelectionOp ( SelectionOp::PredicateType::EQUALS, 11,
-        new ScanOp ( relation.r, relation.len )
-    );
-
-    // Query2: SELECT SUM(x) FROM rel WHERE x <> 12 AND x <> 11 AND x <> 42 AND x <> 43;
-    querys[2] = new AggregationOp ( AggregationOp::SUM,
-        new SelectionOp ( SelectionOp::PredicateType::EQUALS_NOT, 43,
-            new SelectionOp ( SelectionOp::PredicateType::EQUALS_NOT, 42,
-                new SelectionOp ( SelectionOp::PredicateType::EQUALS_NOT, 11,
-                    new SelectionOp ( SelectionOp::PredicateType::EQUALS_NOT, 12,
-                        new ScanOp ( relation.r, relation.len )
-                    )
-                )
-            )
-        )
-    );
+    std::array<RelOperator*, 4> querys = buildQuerys ( relation );
 
-    // Query3: SELECT sum(x) FROM rel;
-    querys[3] = new AggregationOp ( AggregationOp::SUM,
-        new ScanOp ( relation.r, RELATION_LEN )
-    );
-
-    double tVol=0.0, tOp=0.0, tVec=0.0;
+    double tVol=0.0, tOp=0.0, tVec=0.0, tBitmap=0.0, tFused=0.0;
 
     if ( doVec )  tVec  = execVectorization ( querys[query] );
     if ( doVol )  tVol  = execVolcano ( querys[query] );
     if ( doOp )   tOp   = execOperatorAtATime ( querys[query] );
+    if ( doBitmap ) tBitmap = execFilterMode ( querys[query], SelectionOp::FilterMode::BITMAP, "Materialization with bitmaps" );
+    if ( doFused )  tFused  = execFilterMode ( querys[query], SelectionOp::FilterMode::FUSED, "Fused filter and aggregation" );
+
+    if ( doVol || doOp || doVec || doBitmap || doFused ) {
+        csvHeader ();
+        csvStats ( tVol, tOp, tVec, tBitmap, tFused );
+    }
+
+    // run all queries concurrently, once with a private scan each and once sharing a single scan
+    if ( doShared ) {
+        std::array<RelOperator*, 4> independentQuerys = buildQuerys ( relation );
+        double tIndependent = execConcurrent ( independentQuerys, "Concurrent (private scans)" );
+        for (auto q : independentQuerys) {
+          q->deletePlan();
+        }
+
+        SharedScan sharedScan ( relation.r, relation.len );
+        std::array<RelOperator*, 4> sharedQuerys = buildQuerys ( relation, &sharedScan );
+        double tShared = execConcurrent ( sharedQuerys, "Concurrent (shared scan)" );
+        for (auto q : sharedQuerys) {
+          q->deletePlan();
+        }
+
+        csvSharedStats ( tIndependent, tShared );
+    }
+
+    // maintain the aggregates incrementally while appending to a copy of the relation
+    if ( doIncr ) {
+        execIncremental ( "db_append.dat", BATCH_SIZE, 10 );
+    }
 
-    csvHeader ();
-    csvStats ( tVol, tOp, tVec );
+    // repeat all queries through the result cache, regenerates the relation
+    if ( doCache ) {
+        execCached ( &relation, dbFile, 6 );
+    }
 
     for (auto q : querys) {
       q->deletePlan();
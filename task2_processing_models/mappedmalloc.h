@@ -92,6 +92,40 @@ void* map_memory_file ( const char* filepath, size_t* sizeOut ) {
 }
 
 
+void* extend_memory_mapped_file ( void* ptr, size_t newSize, const char* filepath ) {
+    // Unmap the old mapping first, its size is stored in the first index
+    size_t* baseptr = ((size_t*)(ptr))-1;
+    if (munmap(baseptr, *baseptr) == -1) {
+        ERROR("un-mmapping file");
+    }
+
+    int fd = open(filepath, O_RDWR, (mode_t)0600);
+    if (fd == -1) {
+        ERROR("Opening file")
+    }
+
+    // Grow the file and update the filesize stored in the first index
+    size_t filesize = sizeof(newSize) + newSize + 1; // len + content + \0 character
+    if (ftruncate(fd, filesize) == -1) {
+        close(fd);
+        ERROR("calling ftruncate() to grow the file");
+    }
+    if (pwrite(fd, &filesize, sizeof(filesize), 0) == -1) {
+        close(fd);
+        ERROR("writing file len (size_t) to first byte of the file");
+    }
+
+    // Map the grown file, the old content is kept
+    char* map = (char*)mmap(0, filesize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        ERROR("mmapping the file");
+    }
+    close(fd);
+    return map+8;
+}
+
+
 void unmap_memory_file ( void* ptr ) {
     size_t* baseptr = ((size_t*)(ptr))-1;
     size_t size = *(baseptr);
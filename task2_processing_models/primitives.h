@@ -1,5 +1,10 @@
 #pragma once
 
+#include <cstdint>
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
 #include "DBData.h"
 
 
@@ -107,3 +112,236 @@ static __inline__ size_t aggCount ( Tuple* inTuples, size_t n ) {
 }
 
  
+
+
+/* Comparisons of the bitmap primitives, the values match the AVX-512 integer comparison predicates. */
+enum CmpType { CMP_EQ = 0, CMP_LT = 1, CMP_NE = 4 };
+
+/* How a predicate bitmap is combined with the bitmap it is written to. */
+enum BitmapCombine { BITMAP_SET, BITMAP_AND };
+
+
+static __inline__ size_t bitmapWords ( size_t n ) {
+    return ( n + 63 ) / 64;
+}
+
+
+template <CmpType CMP>
+static __inline__ uint64_t cmpScalar ( Tuple a, long int b ) {
+    return ( CMP == CMP_EQ ) ? ( a == b ) : ( ( CMP == CMP_LT ) ? ( a < b ) : ( a != b ) );
+}
+
+
+template <BitmapCombine COMBINE>
+static __inline__ void combineWord ( uint64_t* bitmap, size_t w, uint64_t word ) {
+    switch ( COMBINE ) {
+        case BITMAP_SET: bitmap[w] = word; break;
+        case BITMAP_AND: bitmap[w] &= word; break;
+    }
+}
+
+
+/**
+  * @brief Evaluate inTuples[i] CMP val for n tuples into bit i of the packed bitmap.
+  * Bits beyond n in the last word are cleared (or kept cleared).
+  */
+template <CmpType CMP, BitmapCombine COMBINE>
+static __inline__ void cmpMask ( Tuple* inTuples, long int val, uint64_t* bitmap, size_t n ) {
+    size_t i=0;
+    size_t w=0;
+#if defined(__AVX512F__)
+    __m512i constants = _mm512_set1_epi64 ( val );
+    for(; i+64<=n; i+=64, w++) {
+        uint64_t word = 0;
+        for ( size_t k=0; k<8; k++ ) {
+            __m512i values = _mm512_loadu_si512 ( inTuples + i + 8*k );
+            word |= (uint64_t) _mm512_cmp_epi64_mask ( values, constants, CMP ) << ( 8*k );
+        }
+        combineWord<COMBINE> ( bitmap, w, word );
+    }
+#endif
+    for(; i<n; i+=64, w++) {
+        uint64_t word = 0;
+        size_t end = ( i+64 <= n ) ? 64 : n-i;
+        for ( size_t k=0; k<end; k++ ) {
+            word |= cmpScalar<CMP> ( inTuples[i+k], val ) << k;
+        }
+        combineWord<COMBINE> ( bitmap, w, word );
+    }
+}
+
+
+/**
+  * @brief Write all tuples with a set bit to outTuples, which may be inTuples.
+  */
+static __inline__ size_t compactBitmap ( Tuple* inTuples, const uint64_t* bitmap, Tuple* outTuples, size_t n ) {
+    size_t nOut=0;
+    size_t i=0;
+    size_t w=0;
+#if defined(__AVX512F__)
+    for(; i+64<=n; i+=64, w++) {
+        uint64_t word = bitmap[w];
+        for ( size_t k=0; k<8; k++ ) {
+            __mmask8 mask = (__mmask8) ( word >> ( 8*k ) );
+            __m512i values = _mm512_loadu_si512 ( inTuples + i + 8*k );
+            _mm512_mask_compressstoreu_epi64 ( outTuples + nOut, mask, values );
+            nOut += __builtin_popcount ( mask );
+        }
+    }
+#endif
+    for(; i<n; i+=64, w++) {
+        uint64_t word = bitmap[w];
+        while ( word != 0 ) {
+            outTuples[nOut++] = inTuples[i + __builtin_ctzll ( word )];
+            word &= word - 1;
+        }
+    }
+    return nOut;
+}
+
+
+static __inline__ long int aggSumBitmap ( Tuple* inTuples, const uint64_t* bitmap, size_t n ) {
+    long int sum = 0;
+    size_t i=0;
+    size_t w=0;
+#if defined(__AVX512F__)
+    __m512i sums = _mm512_setzero_si512();
+    for(; i+64<=n; i+=64, w++) {
+        uint64_t word = bitmap[w];
+        for ( size_t k=0; k<8; k++ ) {
+            __m512i values = _mm512_loadu_si512 ( inTuples + i + 8*k );
+            sums = _mm512_mask_add_epi64 ( sums, (__mmask8) ( word >> ( 8*k ) ), sums, values );
+        }
+    }
+    alignas(64) long int lanes[8];
+    _mm512_store_si512 ( lanes, sums );
+    for ( size_t k=0; k<8; k++ ) {
+        sum += lanes[k];
+    }
+#endif
+    for(; i<n; i+=64, w++) {
+        uint64_t word = bitmap[w];
+        while ( word != 0 ) {
+            sum += inTuples[i + __builtin_ctzll ( word )];
+            word &= word - 1;
+        }
+    }
+    return sum;
+}
+
+
+static __inline__ size_t aggCountBitmap ( const uint64_t* bitmap, size_t n ) {
+    size_t count = 0;
+    size_t words = bitmapWords ( n );
+    for ( size_t w=0; w<words; w++ ) {
+        count += __builtin_popcountll ( bitmap[w] );
+    }
+    return count;
+}
+
+
+/* Maximum number of <> constants evaluated with SIMD by the fused primitives. */
+static constexpr size_t FUSED_MAX_CONSTANTS = 16;
+
+/**
+  * @brief Aggregate all tuples with x < bound (if LESS) and x not in notIn in one pass.
+  * Computes the sum (SUM) or the count of the qualifying tuples without writing them.
+  */
+template <bool SUM, bool LESS>
+static __inline__ long int aggWhereLessNotIn ( Tuple* inTuples, long int bound, const long int* notIn, size_t nNotIn, size_t n ) {
+    long int agg = 0;
+    size_t i=0;
+#if defined(__AVX512F__)
+    if ( nNotIn <= FUSED_MAX_CONSTANTS ) {
+        __m512i constants[FUSED_MAX_CONSTANTS];
+        for ( size_t k=0; k<nNotIn; k++ ) {
+            constants[k] = _mm512_set1_epi64 ( notIn[k] );
+        }
+        __m512i bounds = _mm512_set1_epi64 ( bound );
+        __m512i sums0 = _mm512_setzero_si512();
+        __m512i sums1 = _mm512_setzero_si512();
+        for(; i+16<=n; i+=16) {
+            __m512i values0 = _mm512_loadu_si512 ( inTuples + i );
+            __m512i values1 = _mm512_loadu_si512 ( inTuples + i + 8 );
+            __mmask8 mask0 = LESS ? _mm512_cmplt_epi64_mask ( values0, bounds ) : 0xFF;
+            __mmask8 mask1 = LESS ? _mm512_cmplt_epi64_mask ( values1, bounds ) : 0xFF;
+            for ( size_t k=0; k<nNotIn; k++ ) {
+                mask0 = _mm512_mask_cmpneq_epi64_mask ( mask0, values0, constants[k] );
+                mask1 = _mm512_mask_cmpneq_epi64_mask ( mask1, values1, constants[k] );
+            }
+            if ( SUM ) {
+                sums0 = _mm512_mask_add_epi64 ( sums0, mask0, sums0, values0 );
+                sums1 = _mm512_mask_add_epi64 ( sums1, mask1, sums1, values1 );
+            } else {
+                agg += __builtin_popcount ( mask0 ) + __builtin_popcount ( mask1 );
+            }
+        }
+        alignas(64) long int lanes[8];
+        _mm512_store_si512 ( lanes, _mm512_add_epi64 ( sums0, sums1 ) );
+        for ( size_t k=0; k<8; k++ ) {
+            agg += lanes[k];
+        }
+    }
+#endif
+    for(; i<n; i++) {
+        bool qualifies = !LESS || inTuples[i] < bound;
+        for ( size_t k=0; k<nNotIn; k++ ) {
+            qualifies &= ( inTuples[i] != notIn[k] );
+        }
+        agg += SUM ? ( qualifies ? inTuples[i] : 0 ) : qualifies;
+    }
+    return agg;
+}
+
+
+static __inline__ long int sumWhereNotIn ( Tuple* inTuples, const long int* notIn, size_t nNotIn, size_t n ) {
+    return aggWhereLessNotIn<true, false> ( inTuples, 0, notIn, nNotIn, n );
+}
+
+
+static __inline__ size_t countWhereNotIn ( Tuple* inTuples, const long int* notIn, size_t nNotIn, size_t n ) {
+    return aggWhereLessNotIn<false, false> ( inTuples, 0, notIn, nNotIn, n );
+}
+
+
+static __inline__ long int sumWhereLess ( Tuple* inTuples, long int bound, size_t n ) {
+    return aggWhereLessNotIn<true, true> ( inTuples, bound, nullptr, 0, n );
+}
+
+
+static __inline__ size_t countWhereLess ( Tuple* inTuples, long int bound, size_t n ) {
+    return aggWhereLessNotIn<false, true> ( inTuples, bound, nullptr, 0, n );
+}
+
+
+static __inline__ long int sumWhereLessNotIn ( Tuple* inTuples, long int bound, const long int* notIn, size_t nNotIn, size_t n ) {
+    return aggWhereLessNotIn<true, true> ( inTuples, bound, notIn, nNotIn, n );
+}
+
+
+static __inline__ size_t countWhereLessNotIn ( Tuple* inTuples, long int bound, const long int* notIn, size_t nNotIn, size_t n ) {
+    return aggWhereLessNotIn<false, true> ( inTuples, bound, notIn, nNotIn, n );
+}
+
+
+static __inline__ size_t countWhereEquals ( Tuple* inTuples, long int val, size_t n ) {
+    size_t count = 0;
+    size_t i=0;
+#if defined(__AVX512F__)
+    __m512i constants = _mm512_set1_epi64 ( val );
+    for(; i+16<=n; i+=16) {
+        __mmask8 mask0 = _mm512_cmpeq_epi64_mask ( _mm512_loadu_si512 ( inTuples + i ), constants );
+        __mmask8 mask1 = _mm512_cmpeq_epi64_mask ( _mm512_loadu_si512 ( inTuples + i + 8 ), constants );
+        count += __builtin_popcount ( mask0 ) + __builtin_popcount ( mask1 );
+    }
+#endif
+    for(; i<n; i++) {
+        count += ( inTuples[i] == val );
+    }
+    return count;
+}
+
+
+static __inline__ long int sumWhereEquals ( Tuple* inTuples, long int val, size_t n ) {
+    return val * countWhereEquals ( inTuples, val, n );
+}
@@ -0,0 +1,100 @@
+#ifndef HW3_BLOOMFILTER_HPP
+#define HW3_BLOOMFILTER_HPP
+//---------------------------------------------------------------------------
+#include <immintrin.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "HashFunctions.hpp"
+#include "Relation.hpp"
+//---------------------------------------------------------------------------
+/// Register-blocked Bloom filter of the build side keys
+///
+/// All HASH_BITS bits of a key are in one 64-bit word, a lookup reads one word instead of HASH_BITS cache lines and
+/// 8 lookups are one gather. The word is taken from the high bits of the Murmur hash of the key, the bit positions
+/// from its low 6 * HASH_BITS bits. With BITS_PER_KEY bits per key, about 1% of the keys that are not in the filter
+/// pass it.
+class BloomFilter {
+public:
+  static constexpr size_t BITS_PER_KEY = 16;
+  /// Bits set per key
+  static constexpr unsigned HASH_BITS = 4;
+
+  /// Prepare an empty filter for n keys
+  void reset(size_t n) {
+    size_t words = 8;
+    shift_ = 61;
+    while (words * 64 < n * BITS_PER_KEY) {
+      words *= 2;
+      shift_--;
+    }
+    words_.assign(words, 0);
+  }
+
+  void insert(keyType key) {
+    const uint64_t hash = MurmurHash::hash(key);
+    words_[wordOf(hash)] |= maskOf(hash);
+  }
+
+  bool contains(keyType key) const {
+    const uint64_t hash = MurmurHash::hash(key);
+    const uint64_t mask = maskOf(hash);
+    return (words_[wordOf(hash)] & mask) == mask;
+  }
+
+  /// Positions of the tuples among tuples[0, n) whose key may be in the filter, n <= HASH_BATCH
+  /// @return number of selected tuples
+  template <typename Tuple>
+  size_t select(const Tuple *tuples, size_t n, uint32_t *selection) const {
+    uint64_t hashes[HASH_BATCH];
+    SimdMurmurHash::hashBatch(tuples, n, hashes);
+    size_t selected = 0;
+    size_t i = 0;
+#if defined(__AVX512F__)
+    const __m512i one = _mm512_set1_epi64(1);
+    const __m512i six_bits = _mm512_set1_epi64(63);
+    for (; i + 8 <= n; i += 8) {
+      const __m512i hash = _mm512_loadu_si512(hashes + i);
+      const __m512i word_index = simd_srlv(hash, _mm512_set1_epi64(shift_));
+      const __m512i word = simd_gather(word_index, words_.data());
+      __m512i mask = _mm512_setzero_si512();
+      for (unsigned bit = 0; bit < HASH_BITS; bit++) {
+        const __m512i position = _mm512_and_si512(simd_srlv(hash, _mm512_set1_epi64(6 * bit)), six_bits);
+        mask = _mm512_or_si512(mask, simd_sllv(one, position));
+      }
+      for (unsigned passed = _mm512_cmpeq_epi64_mask(_mm512_and_si512(word, mask), mask); passed != 0; passed &= passed - 1) {
+        selection[selected++] = i + __builtin_ctz(passed);
+      }
+    }
+#endif
+    for (; i < n; i++) {
+      const uint64_t mask = maskOf(hashes[i]);
+      selection[selected] = i;
+      selected += (words_[wordOf(hashes[i])] & mask) == mask;
+    }
+    return selected;
+  }
+
+  size_t bytes() const { return words_.size() * sizeof(uint64_t); }
+
+private:
+  size_t wordOf(uint64_t hash) const {
+    return hash >> shift_;
+  }
+
+  static uint64_t maskOf(uint64_t hash) {
+    uint64_t mask = 0;
+    for (unsigned bit = 0; bit < HASH_BITS; bit++) {
+      mask |= uint64_t{1} << ((hash >> (6 * bit)) & 63);
+    }
+    return mask;
+  }
+
+  std::vector<uint64_t> words_;
+  /// 64 - log2(words), at least 8 words
+  unsigned shift_ = 61;
+};
+//---------------------------------------------------------------------------
+#endif  // HW3_BLOOMFILTER_HPP
@@ -0,0 +1,150 @@
+#ifndef HW3_HASHFUNCTIONS_HPP
+#define HW3_HASHFUNCTIONS_HPP
+//---------------------------------------------------------------------------
+#include <immintrin.h>
+#include <stdint.h>
+
+#include <cstring>
+#include <string>
+
+#include "Relation.hpp"
+//---------------------------------------------------------------------------
+/// Keys hashed at once by the partitioners, small enough for the hashes to stay in L1
+static constexpr size_t HASH_BATCH = 64;
+//---------------------------------------------------------------------------
+#if defined(__AVX512F__)
+/// AVX-512 gather and shifts on all 8 lanes, for the hash policies and BloomFilter
+/// They use the zero-masked intrinsics, which compute the same as the unmasked ones. The unmasked ones trip
+/// -Wmaybe-uninitialized of GCC on their undefined passthrough operand.
+static inline __m512i simd_gather(__m512i index, const void *base) {
+  return _mm512_mask_i64gather_epi64(_mm512_setzero_si512(), 0xFF, index, base, 8);
+}
+static inline __m512i simd_srlv(__m512i value, __m512i count) {
+  return _mm512_maskz_srlv_epi64(0xFF, value, count);
+}
+static inline __m512i simd_sllv(__m512i value, __m512i count) {
+  return _mm512_maskz_sllv_epi64(0xFF, value, count);
+}
+#endif
+//---------------------------------------------------------------------------
+/// Hash policies for radix partitioning
+///
+/// Every policy has a hash() for one key and a hashBatch() that hashes the keys of n consecutive tuples (tuple_t or
+/// key_rowid_t). Partitioning uses the low bits of the hash, so a policy has to put its best bits there.
+template <typename Hash>
+struct ScalarBatch {
+  template <typename Tuple>
+  static void hashBatch(const Tuple *tuples, size_t n, uint64_t *out) {
+    for (size_t i = 0; i < n; i++) {
+      out[i] = Hash::hash(tuples[i].key);
+    }
+  }
+};
+//---------------------------------------------------------------------------
+/// std::hash of libstdc++, i.e., the key itself. Structured keys (e.g., multiples of 256) end up in few partitions.
+struct IdentityHash : ScalarBatch<IdentityHash> {
+  static constexpr const char *name = "identity";
+  static uint64_t hash(keyType key) {
+    return key;
+  }
+};
+//---------------------------------------------------------------------------
+/// Multiplicative (Fibonacci) hashing. The good bits of the product are the high ones, the byte swap moves them down.
+struct FibonacciHash : ScalarBatch<FibonacciHash> {
+  static constexpr const char *name = "fibonacci";
+  static uint64_t hash(keyType key) {
+    return __builtin_bswap64(key * 0x9E3779B97F4A7C15ull);
+  }
+};
+//---------------------------------------------------------------------------
+/// Finalizer of MurmurHash3, every input bit affects every output bit
+struct MurmurHash : ScalarBatch<MurmurHash> {
+  static constexpr const char *name = "murmur";
+  static uint64_t hash(keyType key) {
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDull;
+    key ^= key >> 33;
+    key *= 0xC4CEB9FE1A85EC53ull;
+    key ^= key >> 33;
+    return key;
+  }
+};
+//---------------------------------------------------------------------------
+/// CRC32-C of the key with the SSE4.2 instruction, 32 hash bits at a latency of 3 cycles
+struct Crc32Hash : ScalarBatch<Crc32Hash> {
+  static constexpr const char *name = "crc32";
+  static uint64_t hash(keyType key) {
+#ifdef __SSE4_2__
+    return _mm_crc32_u64(0xFFFFFFFFu, key);
+#else
+    return MurmurHash::hash(key) & 0xFFFFFFFFu;
+#endif
+  }
+};
+//---------------------------------------------------------------------------
+/// Murmur finalizer on 8 keys at once with AVX-512, the keys are gathered from the tuples
+struct SimdMurmurHash {
+  static constexpr const char *name = "simd-murmur";
+  static uint64_t hash(keyType key) {
+    return MurmurHash::hash(key);
+  }
+
+  template <typename Tuple>
+  static void hashBatch(const Tuple *tuples, size_t n, uint64_t *out) {
+    size_t i = 0;
+#if defined(__AVX512F__) && defined(__AVX512DQ__)
+    if constexpr (sizeof(tuples->key) == sizeof(keyType)) {  // 64-bit gather, 32-bit keys are hashed scalar
+      constexpr long long stride = sizeof(Tuple) / sizeof(keyType);
+      const __m512i index = _mm512_set_epi64(7 * stride, 6 * stride, 5 * stride, 4 * stride,
+                                             3 * stride, 2 * stride, stride, 0);
+      const __m512i c1 = _mm512_set1_epi64(0xFF51AFD7ED558CCDull);
+      const __m512i c2 = _mm512_set1_epi64(0xC4CEB9FE1A85EC53ull);
+      const __m512i shift = _mm512_set1_epi64(33);
+      for (; i + 8 <= n; i += 8) {
+        __m512i key = simd_gather(index, &tuples[i].key);
+        key = _mm512_xor_si512(key, simd_srlv(key, shift));
+        key = _mm512_mullo_epi64(key, c1);
+        key = _mm512_xor_si512(key, simd_srlv(key, shift));
+        key = _mm512_mullo_epi64(key, c2);
+        key = _mm512_xor_si512(key, simd_srlv(key, shift));
+        _mm512_storeu_si512(out + i, key);
+      }
+    }
+#endif
+    for (; i < n; i++) {
+      out[i] = hash(tuples[i].key);
+    }
+  }
+};
+//---------------------------------------------------------------------------
+/// Hash policies selectable at runtime, e.g., by ohj --hash=<name>
+enum class HashPolicy { IDENTITY, FIBONACCI, MURMUR, CRC32, SIMD_MURMUR };
+
+/// Policy of a name, false if there is none
+inline bool parse_hash_policy(const std::string &name, HashPolicy &policy) {
+  const std::pair<const char *, HashPolicy> policies[] = {
+      {IdentityHash::name, HashPolicy::IDENTITY}, {FibonacciHash::name, HashPolicy::FIBONACCI},
+      {MurmurHash::name, HashPolicy::MURMUR}, {Crc32Hash::name, HashPolicy::CRC32},
+      {SimdMurmurHash::name, HashPolicy::SIMD_MURMUR}};
+  for (const auto &entry : policies) {
+    if (name == entry.first) {
+      policy = entry.second;
+      return true;
+    }
+  }
+  return false;
+}
+
+/// Call f(Hash{}) with the type of the policy, e.g., to instantiate a join template for a policy selected at runtime
+template <typename F>
+decltype(auto) with_hash_policy(HashPolicy policy, F &&f) {
+  switch (policy) {
+    case HashPolicy::FIBONACCI: return f(FibonacciHash{});
+    case HashPolicy::MURMUR: return f(MurmurHash{});
+    case HashPolicy::CRC32: return f(Crc32Hash{});
+    case HashPolicy::SIMD_MURMUR: return f(SimdMurmurHash{});
+    default: return f(IdentityHash{});
+  }
+}
+//---------------------------------------------------------------------------
+#endif  // HW3_HASHFUNCTIONS_HPP
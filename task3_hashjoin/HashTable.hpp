@@ -0,0 +1,141 @@
+#ifndef HW3_HASHTABLE_HPP
+#define HW3_HASHTABLE_HPP
+//---------------------------------------------------------------------------
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "HashFunctions.hpp"
+#include "Relation.hpp"
+//---------------------------------------------------------------------------
+/// Open-addressing hash table for the build side of a join
+///
+/// All entries live in one array of power-of-two size with linear probing, so an insert never allocates and a probe
+/// reads consecutive slots instead of chasing list nodes. Every slot has a 16-bit tag in a separate array, a probe
+/// compares tags first and only touches an entry if its tag matches, and stops at the first empty tag.
+/// The table keeps its memory across reset(), so one table serves all partitions of a radix join.
+/// Entries reference their build tuple (Payload), duplicate keys are allowed.
+template <typename Payload = const tuple_t*>
+class JoinHashTable {
+public:
+  struct Entry {
+    keyType key;
+    Payload payload;
+  };
+
+  /// Prepare an empty table for n build tuples, at most half of the slots are used
+  void reset(size_t n) {
+    size_t capacity = 16;
+    uint64_t bits = 4;
+    while (capacity < 2 * n) {
+      capacity <<= 1;
+      bits++;
+    }
+    if (capacity > tags_.size()) {
+      tags_.assign(capacity, 0);
+      entries_.resize(capacity);
+    } else {
+      std::fill(tags_.begin(), tags_.begin() + capacity, 0);
+    }
+    mask_ = capacity - 1;
+    shift_ = 64 - bits;
+  }
+
+  void insert(keyType key, Payload payload) {
+    const uint64_t hash = hashKey(key);
+    size_t slot = hash >> shift_;
+    while (tags_[slot] != 0) {
+      slot = (slot + 1) & mask_;
+    }
+    tags_[slot] = tagOf(hash);
+    entries_[slot] = Entry{key, payload};
+  }
+
+  /// Call on_match(payload) for every build tuple with the key
+  template <typename Callback>
+  void probe(keyType key, Callback &&on_match) const {
+    const uint64_t hash = hashKey(key);
+    const uint16_t tag = tagOf(hash);
+    for (size_t slot = hash >> shift_; tags_[slot] != 0; slot = (slot + 1) & mask_) {
+      if (tags_[slot] == tag && entries_[slot].key == key) {
+        on_match(entries_[slot].payload);
+      }
+    }
+  }
+
+  /// Group prefetching: on_match(i, payload) for every build tuple with the key of tuples[i], i < n
+  /// The slots of PROBE_GROUP keys are prefetched before the first of them is probed, so their cache misses overlap
+  /// instead of stalling the probes one after another.
+  template <typename Tuple, typename Callback>
+  void probeBatch(const Tuple *tuples, size_t n, Callback &&on_match) const {
+    uint64_t hashes[PROBE_GROUP];
+    for (size_t begin = 0; begin < n; begin += PROBE_GROUP) {
+      const size_t end = std::min(n, begin + PROBE_GROUP);
+      for (size_t i = begin; i < end; i++) {
+        hashes[i - begin] = hashKey(tuples[i].key);
+        prefetchSlot(hashes[i - begin] >> shift_);
+      }
+      for (size_t i = begin; i < end; i++) {
+        const uint64_t hash = hashes[i - begin];
+        const uint16_t tag = tagOf(hash);
+        for (size_t slot = hash >> shift_; tags_[slot] != 0; slot = (slot + 1) & mask_) {
+          if (tags_[slot] == tag && entries_[slot].key == tuples[i].key) {
+            on_match(i, entries_[slot].payload);
+          }
+        }
+      }
+    }
+  }
+
+  /// Prefetch the first slot of key, e.g., for the keys of a batch before probe() of each of them
+  void prefetch(keyType key) const {
+    prefetchSlot(hashKey(key) >> shift_);
+  }
+
+  /// Number of build tuples with the key
+  size_t count(keyType key) const {
+    size_t matches = 0;
+    probe(key, [&matches](const Payload &) { matches++; });
+    return matches;
+  }
+
+  /// Longest run of used slots, the most slots a probe reads
+  size_t longestRun() const {
+    size_t longest = 0;
+    size_t run = 0;
+    for (size_t slot = 0; slot <= mask_; slot++) {
+      run = tags_[slot] != 0 ? run + 1 : 0;
+      longest = std::max(longest, run);
+    }
+    return longest;
+  }
+
+private:
+  /// Probes in flight, about the number of outstanding L1 misses of a core
+  static constexpr size_t PROBE_GROUP = 16;
+
+  /// The tag and the entry of a slot are in different arrays, two cache lines
+  void prefetchSlot(size_t slot) const {
+    __builtin_prefetch(&tags_[slot]);
+    __builtin_prefetch(&entries_[slot]);
+  }
+
+  /// Murmur finalizer, the slot is taken from the high bits, which depend on all key bits. Thus keys of one radix
+  /// partition, which share some key or hash bits, still spread over the whole table. A plain multiplicative hash would
+  /// put them into few slots under FibonacciHash, which partitions on the same high product bits.
+  static uint64_t hashKey(keyType key) {
+    return MurmurHash::hash(key);
+  }
+
+  /// 15 hash bits below the slot bits, the top bit marks the slot as used
+  uint16_t tagOf(uint64_t hash) const {
+    return static_cast<uint16_t>(hash >> (shift_ - 15)) | 0x8000;
+  }
+
+  std::vector<uint16_t> tags_;
+  std::vector<Entry> entries_;
+  size_t mask_ = 0;
+  uint64_t shift_ = 64;
+};
+//---------------------------------------------------------------------------
+#endif  // HW3_HASHTABLE_HPP
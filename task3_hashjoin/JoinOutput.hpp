@@ -0,0 +1,125 @@
+#ifndef HW3_JOINOUTPUT_HPP
+#define HW3_JOINOUTPUT_HPP
+//---------------------------------------------------------------------------
+#include <immintrin.h>
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "Relation.hpp"
+//---------------------------------------------------------------------------
+/// Outputs of the joins
+///
+/// A join calls output.emit(r_tuple, s_tuple) for every match and returns the number of matches. CountOutput
+/// discards the matches, which is what the joins did before. JoinOutput<Result> materializes them.
+struct CountOutput {
+  static constexpr bool materializes = false;
+  void emit(const tuple_t &, const tuple_t &) {}
+};
+//---------------------------------------------------------------------------
+/// Result with the payloads of both tuples, two cache lines
+struct alignas(64) PayloadResult {
+  keyType key;
+  valueType r_value[payload_count];
+  valueType s_value[payload_count];
+
+  PayloadResult(const tuple_t &r, const tuple_t &s) : key(r.key) {
+    std::memcpy(r_value, r.value, sizeof(r_value));
+    std::memcpy(s_value, s.value, sizeof(s_value));
+  }
+};
+//---------------------------------------------------------------------------
+/// Result of late materialization, only the row ids, a consumer fetches the payloads it needs by row id
+struct RowIdResult {
+  uint64_t r_rowid;
+  uint64_t s_rowid;
+
+  RowIdResult(const tuple_t &r, const tuple_t &s) : r_rowid(r.value[ROWID_VALUE]), s_rowid(s.value[ROWID_VALUE]) {}
+};
+//---------------------------------------------------------------------------
+/// Chunked output buffer of one thread
+///
+/// Results are staged in a cache-line aligned buffer and written to the chunk with non-temporal stores once they
+/// fill whole cache lines, so the output does not evict the hash table and the probe side from the caches.
+/// Chunks are allocated on demand and never moved, the output grows without copying.
+/// Every thread of a join owns its output, emit() does not synchronize.
+template <typename Result>
+class JoinOutput {
+public:
+  static constexpr bool materializes = true;
+  /// Results staged before a write, whole cache lines
+  static constexpr size_t STAGE_RESULTS = sizeof(Result) >= CACHE_LINE_BYTES ? 1 : CACHE_LINE_BYTES / sizeof(Result);
+  /// Results per chunk of 1 MiB
+  static constexpr size_t CHUNK_RESULTS = (1 << 20) / sizeof(Result);
+  static_assert((sizeof(Result) * STAGE_RESULTS) % CACHE_LINE_BYTES == 0, "staged results must fill cache lines");
+  static_assert(CHUNK_RESULTS % STAGE_RESULTS == 0, "a write must not cross chunks");
+
+  JoinOutput() = default;
+  JoinOutput(const JoinOutput &) = delete;
+  JoinOutput &operator=(const JoinOutput &) = delete;
+
+  void emit(const tuple_t &r, const tuple_t &s) {
+    new (&stage_[staged_ * sizeof(Result)]) Result(r, s);
+    if (++staged_ == STAGE_RESULTS) {
+      writeStage();
+    }
+  }
+
+  /// Write the remaining staged results with regular stores and order the non-temporal stores before later reads
+  /// Call after the last emit, before reading the results
+  void flush() {
+    if (staged_ != 0) {
+      std::memcpy(static_cast<void *>(slot()), stage_, staged_ * sizeof(Result));
+      written_ += staged_;
+      staged_ = 0;
+    }
+    _mm_sfence();
+  }
+
+  /// Drop all results, keeps the chunks for the next join
+  void clear() {
+    written_ = 0;
+    staged_ = 0;
+  }
+
+  size_t size() const { return written_ + staged_; }
+
+  /// Result i, valid after flush()
+  const Result &operator[](size_t i) const {
+    assert(i < written_);
+    return chunks_[i / CHUNK_RESULTS].get()[i % CHUNK_RESULTS];
+  }
+
+private:
+  struct FreeDeleter {
+    void operator()(Result *chunk) const { std::free(chunk); }
+  };
+
+  /// Position of the next written result, allocates a chunk at chunk boundaries
+  Result *slot() {
+    if (written_ / CHUNK_RESULTS == chunks_.size()) {
+      void *chunk = std::aligned_alloc(CACHE_LINE_BYTES, CHUNK_RESULTS * sizeof(Result));
+      if (!chunk) throw std::bad_alloc();
+      chunks_.emplace_back(static_cast<Result *>(chunk));
+    }
+    return chunks_[written_ / CHUNK_RESULTS].get() + written_ % CHUNK_RESULTS;
+  }
+
+  void writeStage() {
+    assert(written_ % STAGE_RESULTS == 0);  // no emit after a flush with a partial stage
+    storeNontemp(reinterpret_cast<uint8_t *>(slot()), stage_, sizeof(stage_) / CACHE_LINE_BYTES);
+    written_ += STAGE_RESULTS;
+    staged_ = 0;
+  }
+
+  alignas(CACHE_LINE_BYTES) uint8_t stage_[STAGE_RESULTS * sizeof(Result)];
+  size_t staged_ = 0;
+  size_t written_ = 0;
+  std::vector<std::unique_ptr<Result, FreeDeleter>> chunks_;
+};
+//---------------------------------------------------------------------------
+#endif  // HW3_JOINOUTPUT_HPP
@@ -4,48 +4,175 @@
 #include <random>
 #include <cassert>
 #include <unordered_set>
+#include <unordered_map>
 #include <numeric>
 #include <iostream>
 #include <iomanip>
+#include <cmath>
+#include <algorithm>
+#include <type_traits>
+#include <limits>
+#include <memory>
+#include <cstring>
+#include <cstdlib>
+#include <utility>
 #include "Relation.hpp"
+#include "BloomFilter.hpp"
+#include "HashTable.hpp"
+#include "HashFunctions.hpp"
+#include "JoinOutput.hpp"
+#include "Parallel.hpp"
+#include "SimdSort.hpp"
 
-using Partition_Function = void (const partition &p_in, const SplitHelper &split_helper, partition &p_out);
+template <typename Tuple>
+using Basic_Partition_Function = void (const basic_partition<Tuple> &p_in, const SplitHelper &split_helper, basic_partition<Tuple> &p_out);
+using Partition_Function = Basic_Partition_Function<tuple_t>;
 
-// TODO: We can use a better hash function: murmur hashing, fibonacci hashing
-const std::hash<keyType> HASH_FUNCTION;
+/// Durations of the join phases, per partition for build and probe, printed by ohj as performance break-down
+PhaseTimers join_phases;
+
+/// Filter s with a Bloom filter of the keys of r before probing or partitioning it, joins 0 to 4, e.g., ohj --bloom
+bool bloom_filter_probe_side = false;
+
+/// Probe the hash table of join 0 in groups of prefetched keys, e.g., ohj --prefetch
+bool group_prefetch_probe = false;
+
+/// Probe side filtering of the last join with bloom_filter_probe_side
+struct BloomStats {
+  size_t probed{0};
+  size_t passed{0};
+};
+BloomStats bloom_stats;
+
+/// Tuples of s whose key may be in filter, in the order of s, the row ids in value[ROWID_VALUE] are kept
+relation filter_probe_side(const BloomFilter &filter, const relation &s) {
+  relation filtered;
+  filtered.reserve(s.size());  // Only the pages of the passing tuples are touched
+  uint32_t selection[HASH_BATCH];
+  for (size_t begin = 0; begin < s.size(); begin += HASH_BATCH) {
+    const size_t selected = filter.select(s.data() + begin, std::min(HASH_BATCH, s.size() - begin), selection);
+    for (size_t i = 0; i < selected; i++) {
+      filtered.push_back(s[begin + selection[i]]);
+    }
+  }
+  bloom_stats.probed = s.size();
+  bloom_stats.passed = filtered.size();
+  return filtered;
+}
+
+/// Bloom filter of r applied to s for the partitioned joins, a separate pass over r before r is partitioned
+/// @return filtered s, empty if bloom_filter_probe_side is off
+relation bloom_filtered_probe_side(const relation &r, const relation &s, uint64_t &bloom_cycles) {
+  bloom_stats = BloomStats();
+  bloom_cycles = 0;
+  if (!bloom_filter_probe_side) return {};
+  Timer t = Timer();
+  BloomFilter filter;
+  filter.reset(r.size());
+  for (const auto &tuple : r) {
+    filter.insert(tuple.key);
+  }
+  relation filtered = filter_probe_side(filter, s);
+  bloom_cycles = t.cycles();
+  join_phases.record("bloom", bloom_cycles);
+  return filtered;
+}
 
 /// Normal hash join with assumption that relation r is smaller
+/// @param output receives every match, e.g., a JoinOutput to materialize the result
 /// @return number of matched tuples
-uint64_t hash_join(const relation& r, const relation& s) {
+template <typename Output = CountOutput>
+uint64_t hash_join(const relation& r, const relation& s, Output &&output = {}) {
   assert(r.size() <= s.size());
 
-  // Step 1: build phase
+  // Step 1: build phase, the Bloom filter of r is built in the same loop
   Timer t1 = Timer();
-  std::unordered_set<keyType> hash_table;
-  hash_table.reserve(r.size());
+  bloom_stats = BloomStats();
+  BloomFilter filter;
+  if (bloom_filter_probe_side) filter.reset(r.size());
+  JoinHashTable<> hash_table;
+  hash_table.reset(r.size());
   for (const auto& tuple : r) {
-    hash_table.emplace(tuple.key);
+    hash_table.insert(tuple.key, &tuple);
+    if (bloom_filter_probe_side) filter.insert(tuple.key);
   }
-  std::cout << std::fixed << "BUILD: " << std::setprecision(1) << t1.get() << std::endl;
+  const uint64_t build_cycles = t1.cycles();
+  join_phases.record("build", build_cycles);
+  std::cout << std::fixed << "BUILD: " << std::setprecision(1) << cyclesToMilliseconds(build_cycles) << std::endl;
 
   // Step 2: probe phase
   Timer t2 = Timer();
   uint64_t counter{0};
-  for (const auto& tuple : s) {
-    const auto it = hash_table.find(tuple.key);
-    counter += (it != hash_table.end());  // No branching. xD
+  if (bloom_filter_probe_side) {
+    // Only the tuples that pass the filter probe the hash table, the filter is a fraction of its size and stays in cache
+    uint32_t selection[HASH_BATCH];
+    for (size_t begin = 0; begin < s.size(); begin += HASH_BATCH) {
+      const size_t selected = filter.select(s.data() + begin, std::min(HASH_BATCH, s.size() - begin), selection);
+      if (group_prefetch_probe) {
+        for (size_t i = 0; i < selected; i++) hash_table.prefetch(s[begin + selection[i]].key);
+      }
+      for (size_t i = 0; i < selected; i++) {
+        const tuple_t &tuple = s[begin + selection[i]];
+        hash_table.probe(tuple.key, [&](const tuple_t *match) { output.emit(*match, tuple); counter++; });
+      }
+      bloom_stats.passed += selected;
+    }
+    bloom_stats.probed = s.size();
+  } else if (group_prefetch_probe) {
+    hash_table.probeBatch(s.data(), s.size(), [&](size_t i, const tuple_t *match) { output.emit(*match, s[i]); counter++; });
+  } else {
+    for (const auto& tuple : s) {
+      hash_table.probe(tuple.key, [&](const tuple_t *match) { output.emit(*match, tuple); counter++; });
+    }
   }
-  std::cout << std::fixed << "PROBE: " << std::setprecision(1) << t2.get() << std::endl;
+  const uint64_t probe_cycles = t2.cycles();
+  join_phases.record("probe", probe_cycles);
+  std::cout << std::fixed << "PROBE: " << std::setprecision(1) << cyclesToMilliseconds(probe_cycles) << std::endl;
 
   return counter;
 }
 
+/// Sizes of the partitions of one relation
+struct PartitionBalance {
+  size_t partitions{0};
+  size_t empty{0};
+  size_t max{0};
+  double mean{0};
+  double stddev{0};
+};
+
+/// Balance of the partitions of p, i.e., how far the largest partition is from the mean
+template <typename Tuple>
+PartitionBalance partition_balance(const basic_partition<Tuple> &p) {
+  PartitionBalance balance;
+  balance.partitions = p.start_points.size() - 1;
+  for (size_t i = 0; i < balance.partitions; i++) {
+    const size_t size = p.start_points[i + 1] - p.start_points[i];
+    balance.empty += (size == 0);
+    balance.max = std::max(balance.max, size);
+  }
+  balance.mean = static_cast<double>(p.start_points.back() - p.start_points.front()) / balance.partitions;
+  double variance{0};
+  for (size_t i = 0; i < balance.partitions; i++) {
+    const double deviation = (p.start_points[i + 1] - p.start_points[i]) - balance.mean;
+    variance += deviation * deviation / balance.partitions;
+  }
+  balance.stddev = std::sqrt(variance);
+  return balance;
+}
+
+/// Partition balance of r and s of the last partitioned join
+PartitionBalance r_balance, s_balance;
+
 /// Partition p_in into a new partition p_out
 /// The relation in p_out must be allocated
+/// @tparam Hash hash policy of HashFunctions.hpp
+/// @tparam Tuple tuple_t or a compact key_rowid_t
 /// @param[in] p_in input partition
 /// @param[in] split_helper partition pattern
 /// @param[out] p_out output partition
-void partition_impl(const partition &p_in, const SplitHelper &split_helper, partition &p_out) {
+template <typename Hash = IdentityHash, typename Tuple = tuple_t>
+void partition_impl(const basic_partition<Tuple> &p_in, const SplitHelper &split_helper, basic_partition<Tuple> &p_out) {
   for (size_t part_id = 0; part_id < p_in.start_points.size() - 1; part_id++) {
     // Step 0 initialize histogram
     std::vector<size_t> histogram(split_helper.fanOut, 0);
@@ -53,8 +180,13 @@ void partition_impl(const partition &p_in, const SplitHelper &split_helper, part
     const size_t pass_of_end = p_in.start_points[part_id + 1];
 
     // Step 1 build histograms -> Prefix sum
-    for (size_t i = start; i < pass_of_end; i++) {
-      histogram[(HASH_FUNCTION(p_in.relation_[i].key) & split_helper.mask) >> split_helper.coming_bits]++;
+    uint64_t hashes[HASH_BATCH];
+    for (size_t batch = start; batch < pass_of_end; batch += HASH_BATCH) {
+      const size_t batch_size = std::min(HASH_BATCH, pass_of_end - batch);
+      Hash::hashBatch(&p_in.relation_[batch], batch_size, hashes);
+      for (size_t j = 0; j < batch_size; j++) {
+        histogram[(hashes[j] & split_helper.mask) >> split_helper.coming_bits]++;
+      }
     }
     assert(std::accumulate(histogram.begin(), histogram.end(), decltype(histogram)::value_type(0)) == pass_of_end - start);
 
@@ -72,9 +204,13 @@ void partition_impl(const partition &p_in, const SplitHelper &split_helper, part
     // Step 3 partition
     std::vector<size_t> pos(p_out.start_points.end() - (split_helper.fanOut + 1), p_out.start_points.end());  // local position offset book keeping
     assert(pos.size() == split_helper.fanOut + 1);
-    for (size_t i = start; i < pass_of_end; i++) {
-      const auto hash = (HASH_FUNCTION(p_in.relation_[i].key) & split_helper.mask) >> split_helper.coming_bits;
-      p_out.relation_[pos[hash]++] = p_in.relation_[i];
+    for (size_t batch = start; batch < pass_of_end; batch += HASH_BATCH) {
+      const size_t batch_size = std::min(HASH_BATCH, pass_of_end - batch);
+      Hash::hashBatch(&p_in.relation_[batch], batch_size, hashes);
+      for (size_t i = batch; i < batch + batch_size; i++) {
+        const auto hash = (hashes[i - batch] & split_helper.mask) >> split_helper.coming_bits;
+        p_out.relation_[pos[hash]++] = p_in.relation_[i];
+      }
     }
 
     // Check if all correctly copied
@@ -83,12 +219,106 @@ void partition_impl(const partition &p_in, const SplitHelper &split_helper, part
 }
 
 
+/// Split every partition of p in place, partition by partition
+/// A partition is copied into a scratch buffer that stays in the cache and scattered back, so the output lines are
+/// still cached when they are written and no second relation has to be allocated
+/// @tparam Hash hash policy of HashFunctions.hpp
+/// @tparam Tuple tuple_t or a compact key_rowid_t
+/// @param[in] split_helper partition pattern of the split
+/// @param[in,out] p partition, its start points are replaced by the ones of the split
+template <typename Hash = IdentityHash, typename Tuple = tuple_t>
+void refine_partitions_in_place(const SplitHelper &split_helper, basic_partition<Tuple> &p) {
+  std::vector<size_t> start_points;
+  std::swap(start_points, p.start_points);
+  size_t largest = 0;
+  for (size_t part_id = 0; part_id < start_points.size() - 1; part_id++) largest = std::max(largest, start_points[part_id + 1] - start_points[part_id]);
+  std::unique_ptr<Tuple, decltype(&std::free)> scratch(static_cast<Tuple *>(std::malloc(std::max<size_t>(largest, 1) * sizeof(Tuple))), &std::free);
+  if (!scratch) throw std::bad_alloc();
+
+  Tuple *out = p.relation_.data();
+  std::vector<size_t> pos(split_helper.fanOut);
+  uint64_t hashes[HASH_BATCH];
+  p.start_points.push_back(start_points.front());
+  for (size_t part_id = 0; part_id < start_points.size() - 1; part_id++) {
+    const size_t start = start_points[part_id];
+    const size_t size = start_points[part_id + 1] - start;
+    std::memcpy(static_cast<void *>(scratch.get()), out + start, size * sizeof(Tuple));
+
+    // Step 1 build histograms -> Prefix sum
+    std::fill(pos.begin(), pos.end(), 0);
+    for (size_t batch = 0; batch < size; batch += HASH_BATCH) {
+      const size_t batch_size = std::min(HASH_BATCH, size - batch);
+      Hash::hashBatch(scratch.get() + batch, batch_size, hashes);
+      for (size_t j = 0; j < batch_size; j++) {
+        pos[(hashes[j] & split_helper.mask) >> split_helper.coming_bits]++;
+      }
+    }
+    size_t offset = start;
+    for (size_t i = 0; i < split_helper.fanOut; i++) {
+      offset += std::exchange(pos[i], offset);
+      p.start_points.push_back(offset);
+    }
+    assert(offset == start + size);
+
+    // Step 2 scatter back, the lines of the partition were just read and are still cached
+    for (size_t batch = 0; batch < size; batch += HASH_BATCH) {
+      const size_t batch_size = std::min(HASH_BATCH, size - batch);
+      Hash::hashBatch(scratch.get() + batch, batch_size, hashes);
+      for (size_t j = 0; j < batch_size; j++) {
+        out[pos[(hashes[j] & split_helper.mask) >> split_helper.coming_bits]++] = scratch.get()[batch + j];
+      }
+    }
+  }
+}
+
 /// Partition p_in into a new partition p_out with software managed buffer
 /// The relation in p_out must be allocated
+///
+/// Every partition has a buffer of whole cache lines: several lines for small fan-outs, fewer when the buffers of a
+/// large fan-out would exceed SOFTWARE_BUFFER_BUDGET. Beyond SOFTWARE_BUFFER_MAX_FANOUT tuples narrower than a cache
+/// line are partitioned on the upper half of the bits and each partition is refined in place. The buffer of a partition
+/// mirrors a cache-line aligned window of the output. A full window is written with non-temporal stores, only the first
+/// window of a partition, which starts before the partition, and its last window are written with regular stores.
+/// Tuples of a cache line or more are streamed directly. The scatter touches one TLB entry per flushed window instead
+/// of one per tuple, and the output is backed by huge pages.
+/// @tparam Hash hash policy of HashFunctions.hpp
+/// @tparam Tuple tuple_t or a compact key_rowid_t
 /// @param[in] p_in input partition
 /// @param[in] split_helper partition pattern
 /// @param[out] p_out output partition
-void partition_software_managed_buffer_impl(const partition &p_in, const SplitHelper &split_helper, partition &p_out) {
+template <typename Hash = IdentityHash, typename Tuple = tuple_t>
+void partition_software_managed_buffer_impl(const basic_partition<Tuple> &p_in, const SplitHelper &split_helper, basic_partition<Tuple> &p_out) {
+  static_assert(sizeof(Tuple) % CACHE_LINE_BYTES == 0 || CACHE_LINE_BYTES % sizeof(Tuple) == 0, "tuples must tile cache lines");
+  constexpr bool wide = sizeof(Tuple) >= CACHE_LINE_BYTES;
+  constexpr size_t tuples_per_line = wide ? 1 : CACHE_LINE_BYTES / sizeof(Tuple);
+  const size_t lines = std::clamp<size_t>(SOFTWARE_BUFFER_BUDGET / (split_helper.fanOut * CACHE_LINE_BYTES), 1, SOFTWARE_BUFFER_MAX_LINES);
+  const size_t window = wide ? 1 : lines * tuples_per_line;  // tuples per buffer
+  if (!wide && split_helper.fanOut > SOFTWARE_BUFFER_MAX_FANOUT) {
+    // Two passes on half of the bits each, the first one on the upper half, give the same partitions in the same order
+    const uint64_t bits = __builtin_ctzll(split_helper.fanOut);
+    const uint64_t second_bits = bits / 2;
+    partition_software_managed_buffer_impl<Hash, Tuple>(p_in, SplitHelper(bits - second_bits, split_helper.coming_bits + second_bits), p_out);
+    refine_partitions_in_place<Hash, Tuple>(SplitHelper(second_bits, split_helper.coming_bits), p_out);
+    return;
+  }
+
+  ///  Init Software Managed Buffer
+  Tuple *out = p_out.relation_.data();
+  assert(reinterpret_cast<uintptr_t>(out) % (wide ? CACHE_LINE_BYTES : sizeof(Tuple)) == 0);
+  adviseHugePages(out, p_out.relation_.capacity() * sizeof(Tuple));
+  std::unique_ptr<Tuple, decltype(&std::free)> buffer(
+      static_cast<Tuple *>(std::aligned_alloc(CACHE_LINE_BYTES, wide ? CACHE_LINE_BYTES : split_helper.fanOut * window * sizeof(Tuple))), &std::free);
+  if (!buffer) throw std::bad_alloc();
+
+  /// Write position of a partition, the buffer holds the output positions [window_begin, pos)
+  struct Slot {
+    size_t pos;
+    size_t window_begin;  // cache line aligned, may wrap below 0 for the first partition
+    size_t begin;
+    Tuple *buffer;  // window tuples
+  };
+  std::vector<Slot> slots(split_helper.fanOut);
+
   for (size_t part_id = 0; part_id < p_in.start_points.size() - 1; part_id++) {
     // Step 0 initialize histogram
     std::vector<size_t> histogram(split_helper.fanOut, 0);
@@ -96,8 +326,13 @@ void partition_software_managed_buffer_impl(const partition &p_in, const SplitHe
     const size_t pass_of_end = p_in.start_points[part_id + 1];
 
     // Step 1 build histograms -> Prefix sum
-    for (size_t i = start; i < pass_of_end; i++) {
-      histogram[(HASH_FUNCTION(p_in.relation_[i].key) & split_helper.mask) >> split_helper.coming_bits]++;
+    uint64_t hashes[HASH_BATCH];
+    for (size_t batch = start; batch < pass_of_end; batch += HASH_BATCH) {
+      const size_t batch_size = std::min(HASH_BATCH, pass_of_end - batch);
+      Hash::hashBatch(&p_in.relation_[batch], batch_size, hashes);
+      for (size_t j = 0; j < batch_size; j++) {
+        histogram[(hashes[j] & split_helper.mask) >> split_helper.coming_bits]++;
+      }
     }
     assert(std::accumulate(histogram.begin(), histogram.end(), decltype(histogram)::value_type(0)) == pass_of_end - start);
 
@@ -113,62 +348,86 @@ void partition_software_managed_buffer_impl(const partition &p_in, const SplitHe
     assert(p_out.start_points.size() == split_helper.fanOut * (part_id + 1) + 1);
 
     // Step 3 partition
-    ///  Init Software Managed Buffer
-    std::vector<tuple_t> buffer;
-    buffer.reserve(SOFTWARE_BUFFER_SIZE * split_helper.fanOut);
-
-    std::vector<size_t> pos(p_out.start_points.end() - (split_helper.fanOut + 1), p_out.start_points.end());  // local position offset book keeping
-    assert(pos.size() == split_helper.fanOut + 1);
-
-    /// Assume the first element is aligned
-    std::vector<size_t> before_aligned_counter;
     for (size_t i = 0; i < split_helper.fanOut; i++) {
-      before_aligned_counter.push_back(((32 - ((pos[i] * sizeof(tuple_t)) & 31)) / sizeof(tuple_t)) & 3);
+      const size_t begin = p_out.start_points[split_helper.fanOut * part_id + i];
+      slots[i] = Slot{begin, begin - (reinterpret_cast<uintptr_t>(out + begin) % CACHE_LINE_BYTES) / sizeof(Tuple), begin, buffer.get() + (wide ? 0 : i * window)};
     }
-    const std::vector<size_t> before_aligned(before_aligned_counter);
-
-    for (size_t i = start; i < pass_of_end; i++) {
-      const auto hash = (HASH_FUNCTION(p_in.relation_[i].key) & split_helper.mask) >> split_helper.coming_bits;
-      /// Alignment Preparation -- AVX2 32 bytes aligned
-      if ((before_aligned_counter[hash] != 0) && (reinterpret_cast<uintptr_t>(&p_out.relation_[pos[hash] - SOFTWARE_BUFFER_SIZE]) & 31) != 0) {
-        p_out.relation_[pos[hash]++] = p_in.relation_[i];
-        before_aligned_counter[hash]--;
-      } else {
+    for (size_t batch = start; batch < pass_of_end; batch += HASH_BATCH) {
+      const size_t batch_size = std::min(HASH_BATCH, pass_of_end - batch);
+      Hash::hashBatch(&p_in.relation_[batch], batch_size, hashes);
+      for (size_t i = batch; i < batch + batch_size; i++) {
+        Slot &slot = slots[(hashes[i - batch] & split_helper.mask) >> split_helper.coming_bits];
+        if constexpr (wide) {
+          storeNontemp(reinterpret_cast<uint8_t *>(out + slot.pos++), reinterpret_cast<uint8_t *>(const_cast<Tuple *>(&p_in.relation_[i])),
+                       sizeof(Tuple) / CACHE_LINE_BYTES);
+          continue;
+        }
         ///  Write into Software Managed Buffer
-        const size_t offset_in_buffer = (pos[hash] - p_out.start_points[hash] - before_aligned[hash]) & SOFTWARE_BUFFER_MASK;
-        buffer[hash * SOFTWARE_BUFFER_SIZE + offset_in_buffer] = p_in.relation_[i];
-
-        ///  Flush Software Managed Buffer at Cache Line Boundaries == When Software Buffer Full
-        if (offset_in_buffer == SOFTWARE_BUFFER_MASK) {
-          assert((reinterpret_cast<uintptr_t>(&p_out.relation_[pos[hash] - SOFTWARE_BUFFER_SIZE + 1]) & 31) == 0);
-          storeNontemp(reinterpret_cast<uint8_t*>(&p_out.relation_[pos[hash] - SOFTWARE_BUFFER_SIZE + 1]),
-                       reinterpret_cast<uint8_t*>(&buffer[hash * SOFTWARE_BUFFER_SIZE]));
+        slot.buffer[slot.pos - slot.window_begin] = p_in.relation_[i];
+        ///  Flush Software Managed Buffer When Full
+        if (++slot.pos == slot.window_begin + window) {
+          if (slot.pos - slot.begin >= window) {
+            storeNontemp(reinterpret_cast<uint8_t *>(out + slot.window_begin), reinterpret_cast<uint8_t *>(slot.buffer), window * sizeof(Tuple) / CACHE_LINE_BYTES);
+          } else {
+            // the window starts in the previous partition
+            std::memcpy(static_cast<void *>(out + slot.begin), slot.buffer + (slot.begin - slot.window_begin), (slot.pos - slot.begin) * sizeof(Tuple));
+          }
+          slot.window_begin = slot.pos;
         }
-        pos[hash]++;
       }
     }
 
     /// Flush Out Remaining Data From buffer
-    for (size_t i = 0; i < split_helper.fanOut; i++) {
-      const size_t num_remaining_in_buffer = (pos[i] - p_out.start_points[i] - before_aligned[i]) & SOFTWARE_BUFFER_MASK;
-      for (size_t it = 0; it < num_remaining_in_buffer; it++) {
-        p_out.relation_[pos[i] - num_remaining_in_buffer + it] = buffer[i * SOFTWARE_BUFFER_SIZE + it];
+    if constexpr (!wide) {
+      for (size_t i = 0; i < split_helper.fanOut; i++) {
+        const Slot &slot = slots[i];
+        const size_t buffered = std::min(slot.pos - slot.window_begin, slot.pos - slot.begin);
+        std::memcpy(static_cast<void *>(out + slot.pos - buffered), slot.buffer + (slot.pos - buffered - slot.window_begin),
+                    buffered * sizeof(Tuple));
       }
     }
 
     // Check if all correctly copied
-    for (size_t i = 1; i < split_helper.fanOut; i++) assert(pos[i - 1] == p_out.start_points[i + part_id * split_helper.fanOut]);
+    for (size_t i = 1; i < split_helper.fanOut; i++) assert(slots[i - 1].pos == p_out.start_points[i + part_id * split_helper.fanOut]);
+  }
+  _mm_sfence();
+}
+
+/// Partition function with the hash policy, e.g., selected by ohj --hash=<name>
+template <typename Tuple = tuple_t>
+Basic_Partition_Function<Tuple> *partition_function_for(HashPolicy policy, bool software_managed_buffer) {
+  if (software_managed_buffer) {
+    switch (policy) {
+      case HashPolicy::FIBONACCI: return partition_software_managed_buffer_impl<FibonacciHash, Tuple>;
+      case HashPolicy::MURMUR: return partition_software_managed_buffer_impl<MurmurHash, Tuple>;
+      case HashPolicy::CRC32: return partition_software_managed_buffer_impl<Crc32Hash, Tuple>;
+      case HashPolicy::SIMD_MURMUR: return partition_software_managed_buffer_impl<SimdMurmurHash, Tuple>;
+      default: return partition_software_managed_buffer_impl<IdentityHash, Tuple>;
+    }
+  }
+  switch (policy) {
+    case HashPolicy::FIBONACCI: return partition_impl<FibonacciHash, Tuple>;
+    case HashPolicy::MURMUR: return partition_impl<MurmurHash, Tuple>;
+    case HashPolicy::CRC32: return partition_impl<Crc32Hash, Tuple>;
+    case HashPolicy::SIMD_MURMUR: return partition_impl<SimdMurmurHash, Tuple>;
+    default: return partition_impl<IdentityHash, Tuple>;
   }
 }
 
 /// Naive partition (1 pass) radix hash join with assumption that relation r is smaller
+/// @param output receives every match, e.g., a JoinOutput to materialize the result
 /// @return number of matched tuples
-uint64_t partition_naive_radix_hash_join(const relation &r, const relation &s, uint64_t first_pass_bits, Partition_Function partition_function) {
+template <typename Output = CountOutput>
+uint64_t partition_naive_radix_hash_join(const relation &r, const relation &s, uint64_t first_pass_bits, Partition_Function partition_function, Output &&output = {}) {
   assert(r.size() <= s.size());
 
+  // Step 0: Bloom filter of r, tuples of s without a match in r are never partitioned
+  uint64_t bloom_cycles{0};
+  relation s_filtered = bloom_filtered_probe_side(r, s, bloom_cycles);
+
   double partition_time{0};
   Timer t1 = Timer();
-  // Step 0: Init all partitions
+  // Init all partitions
   // The Only Pass
   SplitHelper split_helper(first_pass_bits);
 
@@ -181,53 +440,69 @@ uint64_t partition_naive_radix_hash_join(const relation &r, const relation &s, u
   partition_r_out.relation_.reserve(r_size);  // Here only reserve memory, I do not push_back to add elements.
   partition_function(partition_r_in, split_helper, partition_r_out);
 
-  const size_t s_size = s.size();
+  const size_t s_size = bloom_filter_probe_side ? s_filtered.size() : s.size();
   /// In
-  partition partition_s_in(std::move(s));
+  partition partition_s_in(bloom_filter_probe_side ? std::move(s_filtered) : std::move(s));
   partition_s_in.start_points.push_back(0); partition_s_in.start_points.push_back(s_size);
   /// Out
   partition partition_s_out;
   partition_s_out.relation_.reserve(s_size);  // Here only reserve memory, I do not push_back to add elements.
   partition_function(partition_s_in, split_helper, partition_s_out);
+  r_balance = partition_balance(partition_r_out);
+  s_balance = partition_balance(partition_s_out);
 
-  partition_time = t1.get();
+  const uint64_t partition_cycles = t1.cycles();
+  join_phases.record("partition", partition_cycles);
+  partition_time = cyclesToMilliseconds(partition_cycles);
+  const double bloom_time = cyclesToMilliseconds(bloom_cycles);
+  if (bloom_filter_probe_side) std::cout << std::fixed << "BLOOM: " << std::setprecision(1) << bloom_time << "  ";
   std::cout << std::fixed << "PARTITION: " << std::setprecision(1) << partition_time;
 
-  // Step 1: Iterator all partitions
+  // Step 1: Iterator all partitions, one hash table is reused for all of them
+  JoinHashTable<> hash_table;
   uint64_t counter{0};
   double build_time{0};
   double probe_time{0};
   for (size_t i = 0; i < split_helper.fanOut; i++) {
     // Step 1.1: build phase
     Timer tb = Timer();
-    std::unordered_set<keyType> hash_table;
-    hash_table.reserve(partition_r_out.start_points[i + 1] - partition_r_out.start_points[i]);
+    hash_table.reset(partition_r_out.start_points[i + 1] - partition_r_out.start_points[i]);
     for (size_t r_iter = partition_r_out.start_points[i]; r_iter < partition_r_out.start_points[i + 1]; r_iter++) {
-      hash_table.emplace(partition_r_out.relation_[r_iter].key);
+      hash_table.insert(partition_r_out.relation_[r_iter].key, &partition_r_out.relation_[r_iter]);
     }
-    build_time += tb.get();
+    const uint64_t build_cycles = tb.cycles();
+    join_phases.record("build", build_cycles);
+    build_time += cyclesToMilliseconds(build_cycles);
 
     // Step 1.2: probe phase
     Timer tp = Timer();
     for (size_t s_iter = partition_s_out.start_points[i]; s_iter < partition_s_out.start_points[i + 1]; s_iter++) {
-      const auto it = hash_table.find(partition_s_out.relation_[s_iter].key);
-      counter += (it != hash_table.end());  // No branching. xD
+      const tuple_t &tuple = partition_s_out.relation_[s_iter];
+      hash_table.probe(tuple.key, [&](const tuple_t *match) { output.emit(*match, tuple); counter++; });
     }
-    probe_time += tp.get();
+    const uint64_t probe_cycles = tp.cycles();
+    join_phases.record("probe", probe_cycles);
+    probe_time += cyclesToMilliseconds(probe_cycles);
   }
   std::cout << std::fixed << "  BUILD: " << std::setprecision(1) << build_time;
-  std::cout << std::fixed << "  PROBE: " << std::setprecision(1) << probe_time << " | " << (partition_time + build_time + probe_time) << std::endl;
+  std::cout << std::fixed << "  PROBE: " << std::setprecision(1) << probe_time << " | " << (bloom_time + partition_time + build_time + probe_time) << std::endl;
   return counter;
 }
 
 /// Multi-pass partition (2 pass) hash join with assumption that relation r is smaller
+/// @param output receives every match, e.g., a JoinOutput to materialize the result
 /// @return number of matched tuples
-uint64_t partition_multiPass_radix_hash_join(relation &r, relation &s, uint64_t first_pass_bits, uint64_t second_pass_bits, Partition_Function partition_function) {
+template <typename Output = CountOutput>
+uint64_t partition_multiPass_radix_hash_join(relation &r, relation &s, uint64_t first_pass_bits, uint64_t second_pass_bits, Partition_Function partition_function, Output &&output = {}) {
   assert(r.size() <= s.size());
 
+  // Step 0: Bloom filter of r, tuples of s without a match in r are never partitioned
+  uint64_t bloom_cycles{0};
+  relation s_filtered = bloom_filtered_probe_side(r, s, bloom_cycles);
+
   double partition_time{0};
   Timer t1 = Timer();
-  // Step 0: Init all partitions
+  // Init all partitions
   // First Pass
   SplitHelper first_pass_split_helper(first_pass_bits, second_pass_bits);
 
@@ -240,9 +515,9 @@ uint64_t partition_multiPass_radix_hash_join(relation &r, relation &s, uint64_t
   partition_r_first_out.relation_.reserve(r_size);  // Here only reserve memory, I do not push_back to add elements.
   partition_function(partition_r_in, first_pass_split_helper, partition_r_first_out);
 
-  const size_t s_size = s.size();
+  const size_t s_size = bloom_filter_probe_side ? s_filtered.size() : s.size();
   /// In
-  partition partition_s_in(std::move(s));
+  partition partition_s_in(bloom_filter_probe_side ? std::move(s_filtered) : std::move(s));
   partition_s_in.start_points.push_back(0); partition_s_in.start_points.push_back(s_size);
   /// Out -- First Pass
   partition partition_s_first_out;
@@ -260,35 +535,702 @@ uint64_t partition_multiPass_radix_hash_join(relation &r, relation &s, uint64_t
   partition partition_s_second_out;
   partition_s_second_out.relation_.reserve(s_size);  // Here only reserve memory, I do not push_back to add elements.
   partition_function(partition_s_first_out, second_pass_split_helper, partition_s_second_out);
-  partition_time = t1.get();
+  r_balance = partition_balance(partition_r_second_out);
+  s_balance = partition_balance(partition_s_second_out);
+  const uint64_t partition_cycles = t1.cycles();
+  join_phases.record("partition", partition_cycles);
+  partition_time = cyclesToMilliseconds(partition_cycles);
+  const double bloom_time = cyclesToMilliseconds(bloom_cycles);
+  if (bloom_filter_probe_side) std::cout << std::fixed << "BLOOM: " << std::setprecision(1) << bloom_time << "  ";
   std::cout << std::fixed << "PARTITION: " << std::setprecision(1) << partition_time;
 
 
-  // Step 1: Iterator all partitions
+  // Step 1: Iterator all partitions, one hash table is reused for all of them
+  JoinHashTable<> hash_table;
   uint64_t counter{0};
   double build_time{0};
   double probe_time{0};
   for (size_t i = 0; i < first_pass_split_helper.fanOut * second_pass_split_helper.fanOut; i++) {
     // Step 1.1: build phase
     Timer tb = Timer();
-    std::unordered_set<keyType> hash_table;
-    hash_table.reserve(partition_r_second_out.start_points[i + 1] - partition_r_second_out.start_points[i]);
+    hash_table.reset(partition_r_second_out.start_points[i + 1] - partition_r_second_out.start_points[i]);
     for (size_t r_iter = partition_r_second_out.start_points[i]; r_iter < partition_r_second_out.start_points[i + 1]; r_iter++) {
-      hash_table.emplace(partition_r_second_out.relation_[r_iter].key);
+      hash_table.insert(partition_r_second_out.relation_[r_iter].key, &partition_r_second_out.relation_[r_iter]);
     }
-    build_time += tb.get();
+    const uint64_t build_cycles = tb.cycles();
+    join_phases.record("build", build_cycles);
+    build_time += cyclesToMilliseconds(build_cycles);
 
     // Step 1.2: probe phase
     Timer tp = Timer();
     for (size_t s_iter = partition_s_second_out.start_points[i]; s_iter < partition_s_second_out.start_points[i + 1]; s_iter++) {
-      const auto it = hash_table.find(partition_s_second_out.relation_[s_iter].key);
-      counter += (it != hash_table.end());  // No branching. xD
+      const tuple_t &tuple = partition_s_second_out.relation_[s_iter];
+      hash_table.probe(tuple.key, [&](const tuple_t *match) { output.emit(*match, tuple); counter++; });
     }
-    probe_time += tp.get();
+    const uint64_t probe_cycles = tp.cycles();
+    join_phases.record("probe", probe_cycles);
+    probe_time += cyclesToMilliseconds(probe_cycles);
   }
 
   std::cout << std::fixed << "  BUILD: " << std::setprecision(1) << build_time;
-  std::cout << std::fixed << "  PROBE: " << std::setprecision(1) << probe_time << " | " << (partition_time + build_time + probe_time) << std::endl;
+  std::cout << std::fixed << "  PROBE: " << std::setprecision(1) << probe_time << " | " << (bloom_time + partition_time + build_time + probe_time) << std::endl;
+  return counter;
+}
+
+
+/// Histogram of the tuples [begin, end) of in, adds to histogram
+template <typename Hash, typename Tuple>
+void histogram_range(const Tuple *in, size_t begin, size_t end, const SplitHelper &split_helper, size_t *histogram) {
+  uint64_t hashes[HASH_BATCH];
+  for (size_t batch = begin; batch < end; batch += HASH_BATCH) {
+    const size_t batch_size = std::min(HASH_BATCH, end - batch);
+    Hash::hashBatch(in + batch, batch_size, hashes);
+    for (size_t j = 0; j < batch_size; j++) {
+      histogram[(hashes[j] & split_helper.mask) >> split_helper.coming_bits]++;
+    }
+  }
+}
+
+/// Scatter the tuples [begin, end) of in to out, pos[i] is the next write position of partition i
+template <typename Hash, typename Tuple>
+void scatter_range(const Tuple *in, size_t begin, size_t end, const SplitHelper &split_helper, Tuple *out, size_t *pos) {
+  uint64_t hashes[HASH_BATCH];
+  for (size_t batch = begin; batch < end; batch += HASH_BATCH) {
+    const size_t batch_size = std::min(HASH_BATCH, end - batch);
+    Hash::hashBatch(in + batch, batch_size, hashes);
+    for (size_t i = batch; i < batch + batch_size; i++) {
+      out[pos[(hashes[i - batch] & split_helper.mask) >> split_helper.coming_bits]++] = in[i];
+    }
+  }
+}
+
+/// Parallel radix hash join with assumption that relation r is smaller, one pass or two passes if second_pass_bits > 0
+///
+/// Pass 1: every thread builds the histogram of its chunk of the input, a parallel prefix sum over the partitions
+/// gives each thread its own range within every partition, and the threads scatter their chunks into the shared
+/// partitioned relation without synchronization. Pass 2: every partition of pass 1 is one task and partitioned on the
+/// next bits by one thread. Build and probe: every partition is one task, the tasks are taken from a queue largest
+/// first, and every thread reuses its hash table.
+/// @tparam Hash hash policy of HashFunctions.hpp
+/// @param outputs one output per thread, thread t emits its matches into outputs[t], e.g., a
+///                std::vector<JoinOutput<RowIdResult>>(num_threads); a vector of CountOutput is resized
+/// @return number of matched tuples
+template <typename Hash = IdentityHash, typename Outputs = std::vector<CountOutput>>
+uint64_t parallel_radix_hash_join(const relation &r, const relation &s, uint64_t first_pass_bits, uint64_t second_pass_bits, size_t num_threads, Outputs &&outputs = {}) {
+  using Output = typename std::decay_t<Outputs>::value_type;
+  assert(r.size() <= s.size());
+  assert(num_threads > 0);
+  if constexpr (!Output::materializes) {
+    if (outputs.size() < num_threads) outputs.resize(num_threads);
+  }
+  assert(outputs.size() >= num_threads);
+
+  Timer t1 = Timer();
+  // Step 0: Init all partitions, only reserved, the threads touch the memory first
+  const SplitHelper first_pass_split_helper(first_pass_bits, second_pass_bits);
+  const SplitHelper second_pass_split_helper(second_pass_bits);
+  const size_t first_fan_out = first_pass_split_helper.fanOut;
+  const size_t fan_out = first_fan_out * second_pass_split_helper.fanOut;
+  struct Side {
+    const relation &in;
+    /// Out -- First Pass
+    partition first_out;
+    /// Out -- Second Pass
+    partition second_out;
+    /// Histogram of the chunk of each thread, after the prefix sum the write position of the thread in every partition
+    std::vector<std::vector<size_t>> histograms;
+    /// Tuples per partition of the first pass
+    std::vector<size_t> sizes;
+    /// Tuples of the partitions of each thread's prefix sum slice, then the first position of the slice
+    std::vector<size_t> slice_sizes;
+
+    /// Final partitioning
+    const partition &out(bool two_pass) const { return two_pass ? second_out : first_out; }
+  };
+  Side sides[2] = {{r, {}, {}, {}, {}, {}}, {s, {}, {}, {}, {}, {}}};
+  const bool two_pass = second_pass_bits > 0;
+  for (Side &side : sides) {
+    side.first_out.relation_.reserve(side.in.size());  // Here only reserve memory, I do not push_back to add elements.
+    side.first_out.start_points.assign(first_fan_out + 1, side.in.size());
+    if (two_pass) {
+      side.second_out.relation_.reserve(side.in.size());
+      side.second_out.start_points.assign(fan_out + 1, side.in.size());
+    }
+    side.histograms.assign(num_threads, std::vector<size_t>(first_fan_out, 0));
+    side.sizes.assign(first_fan_out, 0);
+    side.slice_sizes.assign(num_threads, 0);
+  }
+
+  Barrier barrier(num_threads);
+  TaskQueue tasks;
+  uint64_t partition_cycles{0};
+  std::vector<uint64_t> build_cycles(fan_out), probe_cycles(fan_out);
+  std::vector<uint64_t> counters(num_threads, 0);
+  run_threads(num_threads, [&](size_t thread_id) {
+    // Step 1: histogram of the chunk of this thread
+    for (Side &side : sides) {
+      histogram_range<Hash>(side.in.data(), side.in.size() * thread_id / num_threads, side.in.size() * (thread_id + 1) / num_threads,
+                            first_pass_split_helper, side.histograms[thread_id].data());
+    }
+    barrier.wait();
+
+    // Step 2: parallel prefix sum, every thread sums the partitions of its slice over all threads ...
+    const size_t slice_begin = first_fan_out * thread_id / num_threads;
+    const size_t slice_end = first_fan_out * (thread_id + 1) / num_threads;
+    for (Side &side : sides) {
+      for (size_t i = slice_begin; i < slice_end; i++) {
+        size_t sum = 0;
+        for (auto &histogram : side.histograms) {
+          const size_t count = histogram[i];
+          histogram[i] = sum;
+          sum += count;
+        }
+        side.sizes[i] = sum;
+        side.slice_sizes[thread_id] += sum;
+      }
+    }
+    barrier.wait();
+    // ... and adds the start of the slice, the tuples of all slices before
+    for (Side &side : sides) {
+      size_t start = std::accumulate(side.slice_sizes.begin(), side.slice_sizes.begin() + thread_id, size_t{0});
+      for (size_t i = slice_begin; i < slice_end; i++) {
+        side.first_out.start_points[i] = start;
+        for (auto &histogram : side.histograms) histogram[i] += start;
+        start += side.sizes[i];
+      }
+    }
+    barrier.wait();
+
+    // Step 3: scatter the chunk of this thread into its ranges of the partitions
+    for (Side &side : sides) {
+      scatter_range<Hash>(side.in.data(), side.in.size() * thread_id / num_threads, side.in.size() * (thread_id + 1) / num_threads,
+                          first_pass_split_helper, side.first_out.relation_.data(), side.histograms[thread_id].data());
+    }
+
+    // Step 4: second pass, one task per partition of the first pass of r and s
+    if (two_pass) {
+      if (thread_id == 0) {
+        std::vector<size_t> task_sizes(2 * first_fan_out);
+        for (size_t i = 0; i < first_fan_out; i++) {
+          task_sizes[i] = sides[0].sizes[i];
+          task_sizes[first_fan_out + i] = sides[1].sizes[i];
+        }
+        tasks.assign(largest_first(task_sizes));
+      }
+      barrier.wait();
+      std::vector<size_t> histogram(second_pass_split_helper.fanOut);
+      size_t task;
+      while (tasks.pop(task)) {
+        Side &side = sides[task / first_fan_out];
+        const size_t part_id = task % first_fan_out;
+        const size_t start = side.first_out.start_points[part_id];
+        const size_t pass_of_end = side.first_out.start_points[part_id + 1];
+        std::fill(histogram.begin(), histogram.end(), 0);
+        histogram_range<Hash>(side.first_out.relation_.data(), start, pass_of_end, second_pass_split_helper, histogram.data());
+        size_t *start_points = &side.second_out.start_points[part_id * second_pass_split_helper.fanOut];
+        size_t pos = start;
+        for (size_t i = 0; i < second_pass_split_helper.fanOut; i++) {
+          start_points[i] = pos;
+          pos += histogram[i];
+          histogram[i] = start_points[i];
+        }
+        scatter_range<Hash>(side.first_out.relation_.data(), start, pass_of_end, second_pass_split_helper,
+                            side.second_out.relation_.data(), histogram.data());
+      }
+    }
+    barrier.wait();
+
+    // Step 5: build and probe, one task per partition
+    if (thread_id == 0) {
+      partition_cycles = t1.cycles();
+      std::vector<size_t> task_sizes(fan_out);
+      for (size_t i = 0; i < fan_out; i++) {
+        const partition &partition_r = sides[0].out(two_pass);
+        const partition &partition_s = sides[1].out(two_pass);
+        task_sizes[i] = partition_r.start_points[i + 1] - partition_r.start_points[i] + partition_s.start_points[i + 1] - partition_s.start_points[i];
+      }
+      tasks.assign(largest_first(task_sizes));
+    }
+    barrier.wait();
+    const partition &partition_r_out = sides[0].out(two_pass);
+    const partition &partition_s_out = sides[1].out(two_pass);
+    Output &output = outputs[thread_id];
+    JoinHashTable<> hash_table;
+    uint64_t counter{0};
+    size_t i;
+    while (tasks.pop(i)) {
+      // Step 5.1: build phase
+      Timer tb = Timer();
+      hash_table.reset(partition_r_out.start_points[i + 1] - partition_r_out.start_points[i]);
+      for (size_t r_iter = partition_r_out.start_points[i]; r_iter < partition_r_out.start_points[i + 1]; r_iter++) {
+        hash_table.insert(partition_r_out.relation_[r_iter].key, &partition_r_out.relation_[r_iter]);
+      }
+      build_cycles[i] = tb.cycles();
+
+      // Step 5.2: probe phase
+      Timer tp = Timer();
+      for (size_t s_iter = partition_s_out.start_points[i]; s_iter < partition_s_out.start_points[i + 1]; s_iter++) {
+        const tuple_t &tuple = partition_s_out.relation_[s_iter];
+        hash_table.probe(tuple.key, [&](const tuple_t *match) { output.emit(*match, tuple); counter++; });
+      }
+      probe_cycles[i] = tp.cycles();
+    }
+    counters[thread_id] = counter;
+    _mm_sfence();  // non-temporal stores of the output before the join of the thread
+  });
+
+  const double partition_time = cyclesToMilliseconds(partition_cycles);
+  const double total_time = t1.get();
+  join_phases.record("partition", partition_cycles);
+  for (size_t i = 0; i < fan_out; i++) {
+    join_phases.record("build", build_cycles[i]);
+    join_phases.record("probe", probe_cycles[i]);
+  }
+  r_balance = partition_balance(sides[0].out(two_pass));
+  s_balance = partition_balance(sides[1].out(two_pass));
+  std::cout << std::fixed << "PARTITION: " << std::setprecision(1) << partition_time;
+  std::cout << std::fixed << "  BUILD + PROBE: " << std::setprecision(1) << total_time - partition_time << " | " << total_time << std::endl;
+  return std::accumulate(counters.begin(), counters.end(), uint64_t{0});
+}
+
+/// Parallel naive partition (1 pass) radix hash join with assumption that relation r is smaller
+/// @param outputs one output per thread, see parallel_radix_hash_join
+/// @return number of matched tuples
+template <typename Hash = IdentityHash, typename Outputs = std::vector<CountOutput>>
+uint64_t partition_parallel_naive_radix_hash_join(const relation &r, const relation &s, uint64_t first_pass_bits, size_t num_threads, Outputs &&outputs = {}) {
+  return parallel_radix_hash_join<Hash>(r, s, first_pass_bits, 0, num_threads, std::forward<Outputs>(outputs));
+}
+
+/// Parallel multi-pass partition (2 pass) radix hash join with assumption that relation r is smaller
+/// @param outputs one output per thread, see parallel_radix_hash_join
+/// @return number of matched tuples
+template <typename Hash = IdentityHash, typename Outputs = std::vector<CountOutput>>
+uint64_t partition_parallel_multiPass_radix_hash_join(const relation &r, const relation &s, uint64_t first_pass_bits, uint64_t second_pass_bits, size_t num_threads, Outputs &&outputs = {}) {
+  assert(second_pass_bits > 0);
+  return parallel_radix_hash_join<Hash>(r, s, first_pass_bits, second_pass_bits, num_threads, std::forward<Outputs>(outputs));
+}
+
+
+/// Merge join of sorted <key, row id> columns of r and s, emits the tuples of r and s the row ids refer to
+template <typename Output>
+uint64_t merge_join_sorted(const relation &r, const uint64_t *r_keys, const uint64_t *r_rowids, size_t r_size,
+                           const relation &s, const uint64_t *s_keys, const uint64_t *s_rowids, size_t s_size, Output &output) {
+  uint64_t counter{0};
+  size_t i = 0, j = 0;
+  while (i < r_size && j < s_size) {
+    if (r_keys[i] < s_keys[j]) {
+      i++;
+    } else if (r_keys[i] > s_keys[j]) {
+      j++;
+    } else {
+      const uint64_t key = r_keys[i];
+      size_t r_end = i, s_end = j;
+      while (r_end < r_size && r_keys[r_end] == key) r_end++;
+      while (s_end < s_size && s_keys[s_end] == key) s_end++;
+      if constexpr (Output::materializes) {
+        for (size_t r_iter = i; r_iter < r_end; r_iter++) {
+          for (size_t s_iter = j; s_iter < s_end; s_iter++) output.emit(r[r_rowids[r_iter]], s[s_rowids[s_iter]]);
+        }
+      }
+      counter += (r_end - i) * (s_end - j);
+      i = r_end;
+      j = s_end;
+    }
+  }
   return counter;
 }
 
+/// Massively parallel sort-merge join (MPSM) with assumption that relation r is smaller
+///
+/// Every thread projects its chunk of r and s to <key, row id> columns and sorts them with SIMD sorting networks,
+/// bitonic merges and a multiway merge (SimdSort.hpp). Then every thread merge joins its sorted run of s with the
+/// sorted runs of r of all threads, there is no global merge. With one thread it is a plain sort-merge join.
+/// @param outputs one output per thread, see parallel_radix_hash_join
+/// @return number of matched tuples
+template <typename Outputs = std::vector<CountOutput>>
+uint64_t mpsm_sort_merge_join(const relation &r, const relation &s, size_t num_threads, Outputs &&outputs = {}) {
+  using Output = typename std::decay_t<Outputs>::value_type;
+  assert(r.size() <= s.size());
+  assert(num_threads > 0);
+  if constexpr (!Output::materializes) {
+    if (outputs.size() < num_threads) outputs.resize(num_threads);
+  }
+  assert(outputs.size() >= num_threads);
+
+  Timer t1 = Timer();
+  /// Sorted runs of each thread
+  struct Run {
+    std::vector<uint64_t> keys;
+    std::vector<uint64_t> rowids;
+  };
+  std::vector<Run> r_runs(num_threads), s_runs(num_threads);
+  Barrier barrier(num_threads);
+  uint64_t sort_cycles{0};
+  std::vector<uint64_t> counters(num_threads, 0);
+  run_threads(num_threads, [&](size_t thread_id) {
+    // Step 1: project and sort the chunks of this thread
+    for (auto [in, runs] : {std::make_pair(&r, &r_runs), std::make_pair(&s, &s_runs)}) {
+      Run &run = (*runs)[thread_id];
+      const size_t begin = in->size() * thread_id / num_threads, end = in->size() * (thread_id + 1) / num_threads;
+      run.keys.resize(end - begin);
+      run.rowids.resize(end - begin);
+      for (size_t i = begin; i < end; i++) {
+        run.keys[i - begin] = (*in)[i].key;
+        run.rowids[i - begin] = i;
+      }
+      sort_key_rowids(run.keys, run.rowids);
+    }
+    barrier.wait();
+    if (thread_id == 0) sort_cycles = t1.cycles();
+
+    // Step 2: merge join the run of s with all runs of r
+    const Run &s_run = s_runs[thread_id];
+    for (const Run &r_run : r_runs) {
+      counters[thread_id] += merge_join_sorted(r, r_run.keys.data(), r_run.rowids.data(), r_run.keys.size(),
+                                               s, s_run.keys.data(), s_run.rowids.data(), s_run.keys.size(), outputs[thread_id]);
+    }
+    _mm_sfence();  // non-temporal stores of the output before the join of the thread
+  });
+
+  const double sort_time = cyclesToMilliseconds(sort_cycles);
+  const uint64_t total_cycles = t1.cycles();
+  join_phases.record("sort", sort_cycles);
+  join_phases.record("merge join", total_cycles - sort_cycles);
+  std::cout << std::fixed << "SORT: " << std::setprecision(1) << sort_time;
+  std::cout << std::fixed << "  MERGE JOIN: " << std::setprecision(1) << cyclesToMilliseconds(total_cycles) - sort_time << " | "
+            << cyclesToMilliseconds(total_cycles) << std::endl;
+  return std::accumulate(counters.begin(), counters.end(), uint64_t{0});
+}
+
+
+/// Skew handling: a key with more estimated tuples than this is a heavy hitter and joined on its own
+static constexpr size_t HEAVY_HITTER_LIMIT = 1024;
+/// Skew handling: tuples taken as evenly spaced sample of each relation to estimate key frequencies
+static constexpr size_t SKEW_SAMPLE_SIZE = 1 << 12;
+/// Skew handling: build-side tuples of a partition whose hash table (two slots per tuple) still fits a 256 KiB L2 cache,
+/// larger partitions are split
+static constexpr size_t SKEW_PARTITION_LIMIT = (256 << 10) / (2 * (sizeof(JoinHashTable<>::Entry) + sizeof(uint16_t)));
+/// Skew handling: radix bits of one split of an oversized partition, up to SKEW_MAX_BITS (crc32 has 32 hash bits)
+static constexpr uint64_t SKEW_SPLIT_BITS = 4;
+static constexpr uint64_t SKEW_MAX_BITS = 32;
+
+/// Skew handling of the last skew-resilient join
+struct SkewStats {
+  size_t heavy_hitters{0};
+  size_t split_partitions{0};
+  size_t sorted_partitions{0};
+};
+SkewStats skew_stats;
+
+/// Keys with more than HEAVY_HITTER_LIMIT estimated tuples in r or s
+std::vector<keyType> heavy_hitters(const relation &r, const relation &s) {
+  std::unordered_map<keyType, size_t> frequency;
+  std::vector<keyType> heavy;
+  for (const relation *rel : {&r, &s}) {
+    frequency.clear();
+    const size_t step = std::max<size_t>(1, rel->size() / SKEW_SAMPLE_SIZE);
+    for (size_t i = 0; i < rel->size(); i += step) {
+      const size_t count = ++frequency[(*rel)[i].key];
+      if (count * step > HEAVY_HITTER_LIMIT && (count - 1) * step <= HEAVY_HITTER_LIMIT) {  // once, when crossing the limit
+        heavy.push_back((*rel)[i].key);
+      }
+    }
+  }
+  std::sort(heavy.begin(), heavy.end());
+  heavy.erase(std::unique(heavy.begin(), heavy.end()), heavy.end());
+  return heavy;
+}
+
+/// Number of matches of two tuple ranges by sorting their keys, for partitions no radix bit can split any more
+uint64_t sort_merge_count(const tuple_t *r_begin, const tuple_t *r_end, const tuple_t *s_begin, const tuple_t *s_end) {
+  std::vector<keyType> r_keys, s_keys;
+  r_keys.reserve(r_end - r_begin);
+  s_keys.reserve(s_end - s_begin);
+  for (auto it = r_begin; it != r_end; it++) r_keys.push_back(it->key);
+  for (auto it = s_begin; it != s_end; it++) s_keys.push_back(it->key);
+  std::sort(r_keys.begin(), r_keys.end());
+  std::sort(s_keys.begin(), s_keys.end());
+
+  uint64_t counter{0};
+  for (size_t i = 0, j = 0; i < r_keys.size() && j < s_keys.size();) {
+    if (r_keys[i] < s_keys[j]) {
+      i++;
+    } else if (s_keys[j] < r_keys[i]) {
+      j++;
+    } else {
+      const keyType key = r_keys[i];
+      uint64_t r_run{0}, s_run{0};
+      for (; i < r_keys.size() && r_keys[i] == key; i++) r_run++;
+      for (; j < s_keys.size() && s_keys[j] == key; j++) s_run++;
+      counter += r_run * s_run;
+    }
+  }
+  return counter;
+}
+
+/// Matches of two tuple ranges by sorting, emitted to the output
+template <typename Output>
+uint64_t sort_merge_join(const tuple_t *r_begin, const tuple_t *r_end, const tuple_t *s_begin, const tuple_t *s_end, Output &output) {
+  if constexpr (!Output::materializes) {
+    return sort_merge_count(r_begin, r_end, s_begin, s_end);
+  } else {
+    std::vector<const tuple_t *> r_tuples, s_tuples;
+    r_tuples.reserve(r_end - r_begin);
+    s_tuples.reserve(s_end - s_begin);
+    for (auto it = r_begin; it != r_end; it++) r_tuples.push_back(it);
+    for (auto it = s_begin; it != s_end; it++) s_tuples.push_back(it);
+    const auto by_key = [](const tuple_t *a, const tuple_t *b) { return a->key < b->key; };
+    std::sort(r_tuples.begin(), r_tuples.end(), by_key);
+    std::sort(s_tuples.begin(), s_tuples.end(), by_key);
+
+    uint64_t counter{0};
+    for (size_t i = 0, j = 0; i < r_tuples.size() && j < s_tuples.size();) {
+      if (r_tuples[i]->key < s_tuples[j]->key) {
+        i++;
+      } else if (s_tuples[j]->key < r_tuples[i]->key) {
+        j++;
+      } else {
+        const keyType key = r_tuples[i]->key;
+        size_t r_run = i;
+        for (; r_run < r_tuples.size() && r_tuples[r_run]->key == key; r_run++) {}
+        for (; j < s_tuples.size() && s_tuples[j]->key == key; j++) {
+          for (size_t k = i; k < r_run; k++) {
+            output.emit(*r_tuples[k], *s_tuples[j]);
+            counter++;
+          }
+        }
+        i = r_run;
+      }
+    }
+    return counter;
+  }
+}
+
+/// Join partition i of r and s, a build side larger than SKEW_PARTITION_LIMIT is split on the next radix bits
+/// @param used_bits radix bits of the hash that all tuples of the partition share
+template <typename Output>
+uint64_t skew_join_partition(const partition &r, const partition &s, size_t i, uint64_t used_bits,
+                             Partition_Function partition_function, JoinHashTable<> &hash_table, Output &output) {
+  const size_t r_begin = r.start_points[i], r_end = r.start_points[i + 1];
+  const size_t s_begin = s.start_points[i], s_end = s.start_points[i + 1];
+  if (r_end - r_begin <= SKEW_PARTITION_LIMIT || s_begin == s_end) {
+    uint64_t counter{0};
+    hash_table.reset(r_end - r_begin);
+    for (size_t r_iter = r_begin; r_iter < r_end; r_iter++) {
+      hash_table.insert(r.relation_[r_iter].key, &r.relation_[r_iter]);
+    }
+    for (size_t s_iter = s_begin; s_iter < s_end; s_iter++) {
+      const tuple_t &tuple = s.relation_[s_iter];
+      hash_table.probe(tuple.key, [&](const tuple_t *match) { output.emit(*match, tuple); counter++; });
+    }
+    return counter;
+  }
+  if (used_bits + SKEW_SPLIT_BITS > SKEW_MAX_BITS) {
+    skew_stats.sorted_partitions++;
+    return sort_merge_join(&r.relation_[r_begin], &r.relation_[r_end], &s.relation_[s_begin], &s.relation_[s_end], output);
+  }
+
+  // Split r and s of the partition on the next SKEW_SPLIT_BITS bits of the hash
+  skew_stats.split_partitions++;
+  SplitHelper split_helper(SKEW_SPLIT_BITS, used_bits);
+  partition r_in, r_out, s_in, s_out;
+  r_in.relation_.assign(r.relation_.begin() + r_begin, r.relation_.begin() + r_end);
+  r_in.start_points = {0, r_end - r_begin};
+  r_out.relation_.reserve(r_end - r_begin);  // Here only reserve memory, I do not push_back to add elements.
+  partition_function(r_in, split_helper, r_out);
+  s_in.relation_.assign(s.relation_.begin() + s_begin, s.relation_.begin() + s_end);
+  s_in.start_points = {0, s_end - s_begin};
+  s_out.relation_.reserve(s_end - s_begin);  // Here only reserve memory, I do not push_back to add elements.
+  partition_function(s_in, split_helper, s_out);
+
+  // A split that keeps all tuples together (few distinct keys, identity hash) would recurse without progress
+  if (partition_balance(r_out).max == r_end - r_begin) {
+    skew_stats.sorted_partitions++;
+    return sort_merge_join(&r.relation_[r_begin], &r.relation_[r_end], &s.relation_[s_begin], &s.relation_[s_end], output);
+  }
+  uint64_t counter{0};
+  for (size_t j = 0; j < split_helper.fanOut; j++) {
+    counter += skew_join_partition(r_out, s_out, j, used_bits + SKEW_SPLIT_BITS, partition_function, hash_table, output);
+  }
+  return counter;
+}
+
+/// Skew-resilient partition radix hash join with assumption that relation r is smaller
+/// Heavy hitters found in a sample are counted per key and removed before partitioning, partitions whose build side
+/// exceeds SKEW_PARTITION_LIMIT are split recursively.
+/// @param output receives every match, e.g., a JoinOutput to materialize the result
+/// @return number of matched tuples
+template <typename Output = CountOutput>
+uint64_t partition_skew_radix_hash_join(const relation &r, const relation &s, uint64_t first_pass_bits, Partition_Function partition_function, Output &&output = {}) {
+  constexpr bool materializes = std::remove_reference_t<Output>::materializes;
+  assert(r.size() <= s.size());
+  skew_stats = SkewStats();
+
+  // Step 0: Heavy hitters, their matches are the product of their frequencies in r and s, or a nested loop over their
+  // tuples if the output materializes them
+  Timer t0 = Timer();
+  const std::vector<keyType> heavy = heavy_hitters(r, s);
+  skew_stats.heavy_hitters = heavy.size();
+  uint64_t counter{0};
+  relation r_light, s_light;
+  if (!heavy.empty()) {
+    JoinHashTable<size_t> heavy_table;
+    heavy_table.reset(heavy.size());
+    for (size_t i = 0; i < heavy.size(); i++) {
+      heavy_table.insert(heavy[i], i);
+    }
+    std::vector<uint64_t> r_count(heavy.size(), 0), s_count(heavy.size(), 0);
+    std::vector<std::vector<const tuple_t *>> r_heavy(materializes ? heavy.size() : 0);
+    r_light.reserve(r.size());
+    for (const auto &tuple : r) {
+      bool is_heavy = false;
+      heavy_table.probe(tuple.key, [&](size_t i) {
+        r_count[i]++;
+        if constexpr (materializes) r_heavy[i].push_back(&tuple);
+        is_heavy = true;
+      });
+      if (!is_heavy) r_light.push_back(tuple);
+    }
+    s_light.reserve(s.size());
+    for (const auto &tuple : s) {
+      bool is_heavy = false;
+      heavy_table.probe(tuple.key, [&](size_t i) {
+        s_count[i]++;
+        if constexpr (materializes) {
+          for (const tuple_t *match : r_heavy[i]) output.emit(*match, tuple);
+        }
+        is_heavy = true;
+      });
+      if (!is_heavy) s_light.push_back(tuple);
+    }
+    for (size_t i = 0; i < heavy.size(); i++) {
+      counter += r_count[i] * s_count[i];
+    }
+  }
+  const relation &r_in = heavy.empty() ? r : r_light;
+  const relation &s_in = heavy.empty() ? s : s_light;
+  const uint64_t skew_cycles = t0.cycles();
+  join_phases.record("heavy hitters", skew_cycles);
+
+  // Step 1: Partition the remaining tuples
+  Timer t1 = Timer();
+  SplitHelper split_helper(first_pass_bits);
+  partition partition_r_in(r_in), partition_r_out;
+  partition_r_in.start_points.push_back(0); partition_r_in.start_points.push_back(r_in.size());
+  partition_r_out.relation_.reserve(r_in.size());  // Here only reserve memory, I do not push_back to add elements.
+  partition_function(partition_r_in, split_helper, partition_r_out);
+  partition partition_s_in(s_in), partition_s_out;
+  partition_s_in.start_points.push_back(0); partition_s_in.start_points.push_back(s_in.size());
+  partition_s_out.relation_.reserve(s_in.size());  // Here only reserve memory, I do not push_back to add elements.
+  partition_function(partition_s_in, split_helper, partition_s_out);
+  r_balance = partition_balance(partition_r_out);
+  s_balance = partition_balance(partition_s_out);
+  const uint64_t partition_cycles = t1.cycles();
+  join_phases.record("partition", partition_cycles);
+
+  // Step 2: Build and probe per partition, splitting the oversized ones
+  Timer t2 = Timer();
+  JoinHashTable<> hash_table;
+  for (size_t i = 0; i < split_helper.fanOut; i++) {
+    counter += skew_join_partition(partition_r_out, partition_s_out, i, first_pass_bits, partition_function, hash_table, output);
+  }
+  const uint64_t join_cycles = t2.cycles();
+  join_phases.record("build+probe", join_cycles);
+
+  std::cout << std::fixed << "HEAVY HITTERS: " << skew_stats.heavy_hitters << " (" << std::setprecision(1) << cyclesToMilliseconds(skew_cycles) << ")";
+  std::cout << "  PARTITION: " << cyclesToMilliseconds(partition_cycles);
+  std::cout << "  BUILD+PROBE: " << cyclesToMilliseconds(join_cycles) << " (" << skew_stats.split_partitions << " split, "
+            << skew_stats.sorted_partitions << " sorted)" << " | "
+            << cyclesToMilliseconds(skew_cycles + partition_cycles + join_cycles) << std::endl;
+  return counter;
+}
+
+/// Whether all keys and row ids of r and s fit the compact tuple Pair
+template <typename Pair>
+bool fits_compact_layout(const relation &r, const relation &s) {
+  using Key = decltype(Pair::key);
+  using RowId = decltype(Pair::rowid);
+  const size_t rows = std::max(r.size(), s.size());
+  if (rows != 0 && rows - 1 > std::numeric_limits<RowId>::max()) return false;
+  for (const relation *rel : {&r, &s}) {
+    for (const auto &tuple : *rel) {
+      if (tuple.key > std::numeric_limits<Key>::max()) return false;
+    }
+  }
+  return true;
+}
+
+/// Naive partition (1 pass) radix hash join on compact <key, row id> pairs with assumption that relation r is smaller
+/// Only the pairs are partitioned and hashed, the matching tuples of r and s are fetched by row id for the output.
+/// The keys and row ids must fit Pair, see fits_compact_layout.
+/// @param output receives every match, e.g., a JoinOutput to materialize the result
+/// @return number of matched tuples
+template <typename Pair, typename Output = CountOutput>
+uint64_t partition_compact_radix_hash_join(const relation &r, const relation &s, uint64_t first_pass_bits, Basic_Partition_Function<Pair> partition_function, Output &&output = {}) {
+  assert(r.size() <= s.size());
+  assert(fits_compact_layout<Pair>(r, s));
+  using Key = decltype(Pair::key);
+  using RowId = decltype(Pair::rowid);
+
+  // Step 0: Project the keys and row ids
+  Timer t0 = Timer();
+  basic_partition<Pair> partition_r_in, partition_s_in;
+  partition_r_in.relation_.reserve(r.size());
+  for (size_t i = 0; i < r.size(); i++) {
+    partition_r_in.relation_.push_back(Pair{static_cast<Key>(r[i].key), static_cast<RowId>(i)});
+  }
+  partition_s_in.relation_.reserve(s.size());
+  for (size_t i = 0; i < s.size(); i++) {
+    partition_s_in.relation_.push_back(Pair{static_cast<Key>(s[i].key), static_cast<RowId>(i)});
+  }
+  const uint64_t project_cycles = t0.cycles();
+  join_phases.record("project", project_cycles);
+
+  // Step 1: Partition the pairs
+  Timer t1 = Timer();
+  SplitHelper split_helper(first_pass_bits);
+  basic_partition<Pair> partition_r_out, partition_s_out;
+  partition_r_in.start_points.push_back(0); partition_r_in.start_points.push_back(r.size());
+  partition_r_out.relation_.reserve(r.size());  // Here only reserve memory, I do not push_back to add elements.
+  partition_function(partition_r_in, split_helper, partition_r_out);
+  partition_s_in.start_points.push_back(0); partition_s_in.start_points.push_back(s.size());
+  partition_s_out.relation_.reserve(s.size());  // Here only reserve memory, I do not push_back to add elements.
+  partition_function(partition_s_in, split_helper, partition_s_out);
+  r_balance = partition_balance(partition_r_out);
+  s_balance = partition_balance(partition_s_out);
+  const uint64_t partition_cycles = t1.cycles();
+  join_phases.record("partition", partition_cycles);
+
+  // Step 2: Build and probe per partition, the hash table maps keys to row ids of r
+  JoinHashTable<RowId> hash_table;
+  uint64_t counter{0};
+  double build_time{0};
+  double probe_time{0};
+  for (size_t i = 0; i < split_helper.fanOut; i++) {
+    // Step 2.1: build phase
+    Timer tb = Timer();
+    hash_table.reset(partition_r_out.start_points[i + 1] - partition_r_out.start_points[i]);
+    for (size_t r_iter = partition_r_out.start_points[i]; r_iter < partition_r_out.start_points[i + 1]; r_iter++) {
+      hash_table.insert(partition_r_out.relation_[r_iter].key, partition_r_out.relation_[r_iter].rowid);
+    }
+    const uint64_t build_cycles = tb.cycles();
+    join_phases.record("build", build_cycles);
+    build_time += cyclesToMilliseconds(build_cycles);
+
+    // Step 2.2: probe phase, payloads are only touched for matches
+    Timer tp = Timer();
+    for (size_t s_iter = partition_s_out.start_points[i]; s_iter < partition_s_out.start_points[i + 1]; s_iter++) {
+      const Pair &pair = partition_s_out.relation_[s_iter];
+      hash_table.probe(pair.key, [&](RowId r_rowid) { output.emit(r[r_rowid], s[pair.rowid]); counter++; });
+    }
+    const uint64_t probe_cycles = tp.cycles();
+    join_phases.record("probe", probe_cycles);
+    probe_time += cyclesToMilliseconds(probe_cycles);
+  }
+
+  std::cout << std::fixed << "PROJECT: " << std::setprecision(1) << cyclesToMilliseconds(project_cycles);
+  std::cout << "  PARTITION: " << cyclesToMilliseconds(partition_cycles);
+  std::cout << "  BUILD: " << build_time;
+  std::cout << "  PROBE: " << probe_time << " | " << (cyclesToMilliseconds(project_cycles + partition_cycles) + build_time + probe_time) << std::endl;
+  return counter;
+}
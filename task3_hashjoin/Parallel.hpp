@@ -0,0 +1,96 @@
+#ifndef HW3_PARALLEL_HPP
+#define HW3_PARALLEL_HPP
+//---------------------------------------------------------------------------
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+//---------------------------------------------------------------------------
+/// Run worker(thread_id) on num_threads threads and wait for all of them, the calling thread is thread 0
+template <typename Worker>
+void run_threads(size_t num_threads, Worker &&worker) {
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads);
+  for (size_t thread_id = 1; thread_id < num_threads; thread_id++) {
+    threads.emplace_back([&worker, thread_id] { worker(thread_id); });
+  }
+  worker(0);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+//---------------------------------------------------------------------------
+/// Reusable barrier of a fixed number of threads, separates the phases of a parallel join
+class Barrier {
+public:
+  explicit Barrier(size_t threads) : threshold_(threads), count_(threads) {}
+
+  void wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const size_t generation = generation_;
+    if (--count_ == 0) {
+      generation_++;
+      count_ = threshold_;
+      cond_.notify_all();
+    } else {
+      cond_.wait(lock, [this, generation] { return generation != generation_; });
+    }
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  const size_t threshold_;
+  size_t count_;
+  size_t generation_ = 0;
+};
+//---------------------------------------------------------------------------
+/// Tasks shared by the threads of a join, a thread takes the next task with one atomic increment
+/// Push the large tasks first, the small ones at the end fill the gaps until all threads finish.
+class TaskQueue {
+public:
+  /// Replace the tasks, not thread-safe, e.g., called by one thread between two barriers
+  void assign(std::vector<size_t> tasks) {
+    tasks_ = std::move(tasks);
+    next_.store(0, std::memory_order_relaxed);
+  }
+
+  /// Next task, false once all tasks are taken
+  bool pop(size_t &task) {
+    const size_t next = next_.fetch_add(1, std::memory_order_relaxed);
+    if (next >= tasks_.size()) return false;
+    task = tasks_[next];
+    return true;
+  }
+
+private:
+  std::vector<size_t> tasks_;
+  std::atomic<size_t> next_{0};
+};
+//---------------------------------------------------------------------------
+/// Task ids 0..sizes.size()-1, larger tasks first
+/// Tasks are bucketed by the highest bit of their size, linear time instead of a sort, the order within a factor of
+/// two is kept.
+inline std::vector<size_t> largest_first(const std::vector<size_t> &sizes) {
+  std::vector<size_t> bucket_starts(65, 0);
+  for (size_t size : sizes) {
+    bucket_starts[64 - (size == 0 ? 64 : __builtin_clzll(size))]++;
+  }
+  size_t start = 0;
+  for (size_t bucket = 65; bucket-- > 0;) {
+    const size_t count = bucket_starts[bucket];
+    bucket_starts[bucket] = start;
+    start += count;
+  }
+  std::vector<size_t> tasks(sizes.size());
+  for (size_t task = 0; task < sizes.size(); task++) {
+    const size_t size = sizes[task];
+    tasks[bucket_starts[64 - (size == 0 ? 64 : __builtin_clzll(size))]++] = task;
+  }
+  return tasks;
+}
+//---------------------------------------------------------------------------
+#endif  // HW3_PARALLEL_HPP
@@ -7,14 +7,26 @@
 //---------------------------------------------------------------------------
 #include <immintrin.h>
 #include <stdint.h>
+#include <sys/mman.h>
 
+#include <algorithm>
+#include <cmath>
+#include <random>
 #include <vector>
-#include <chrono>
+
+#include "../common/CycleTimer.h"
 
 using keyType   = uint64_t;
 using valueType = uint64_t;
 
-static const constexpr int payload_count = 7;
+/// Payload words per tuple, e.g., -DPAYLOAD_COUNT=15 for two cache lines per tuple
+#ifndef PAYLOAD_COUNT
+#define PAYLOAD_COUNT 7
+#endif
+static const constexpr int payload_count = PAYLOAD_COUNT;
+/// Payload word with the row id of a tuple, its position in the generated relation, emitted by late materialization
+static const constexpr int ROWID_VALUE = 0;
+static_assert(payload_count > ROWID_VALUE, "the row id is a payload word");
 
 /// Tuple type as naive row storage
 struct alignas(64) tuple_t {
@@ -28,26 +40,62 @@ struct alignas(64) tuple_t {
    bool operator<(const tuple_t& other) const {
      return (key < other.key);
    }
-
-   tuple_t& operator=(const tuple_t& other) {
-      key = other.key;
-      return *this;
-   }
 };
 
-static_assert(sizeof(tuple_t) == 64);
+static_assert(sizeof(tuple_t) % 64 == 0);
 
 using relation = std::vector<tuple_t>;
 
-/// A partition
-struct partition {
+/// Compact tuple for partitioning: the key and the position of the tuple in its relation
+/// Partitioning moves sizeof(key_rowid_t) instead of sizeof(tuple_t) bytes per tuple, the payloads of the matches are
+/// fetched late by row id.
+template <typename Key, typename RowId>
+struct key_rowid_t {
+   Key key;
+   RowId rowid;
+};
+/// 8 + 8 bytes
+using key_rowid64_t = key_rowid_t<uint64_t, uint64_t>;
+/// 4 + 4 bytes, keys and row ids must be below 2^32
+using key_rowid32_t = key_rowid_t<uint32_t, uint32_t>;
+
+/// A partition of tuples of type Tuple, i.e., tuple_t or key_rowid_t
+template <typename Tuple>
+struct basic_partition {
    /// Relation for data strorage
-   relation relation_;
+   std::vector<Tuple> relation_;
    /// Partition metadata containing last element -- the size of the relation as the past-of-end iterator
    std::vector<size_t> start_points; // Vector containing the starts of the partitions
 
-   partition() = default;
-   partition(relation relation_) : relation_(relation_) {};
+   basic_partition() = default;
+   basic_partition(std::vector<Tuple> relation_) : relation_(relation_) {};
+};
+using partition = basic_partition<tuple_t>;
+//---------------------------------------------------------------------------
+/// Generator of Zipf distributed keys: the key of rank i is drawn with probability proportional to 1 / i^theta
+/// theta = 0 is uniform, at theta = 1.5 the most frequent key makes up 38% of the tuples.
+/// Ranks are scrambled into keys, so the frequent keys are not the small ones.
+class ZipfGenerator {
+public:
+   ZipfGenerator(size_t keys, double theta) : cdf_(keys) {
+      double sum = 0;
+      for (size_t i = 0; i < keys; i++) {
+         sum += std::pow(static_cast<double>(i + 1), -theta);
+         cdf_[i] = sum;
+      }
+      for (auto &p : cdf_) p /= sum;
+   }
+
+   template <typename Generator>
+   keyType operator()(Generator &gen) {
+      const double u = std::uniform_real_distribution<double>(0, 1)(gen);
+      const size_t rank = std::min<size_t>(std::lower_bound(cdf_.begin(), cdf_.end(), u) - cdf_.begin(), cdf_.size() - 1);
+      return (rank + 1) * 0x9E3779B97F4A7C15ull;  // odd multiplier, i.e., distinct ranks give distinct keys
+   }
+
+private:
+   /// Cumulative probabilities of the ranks
+   std::vector<double> cdf_;
 };
 //---------------------------------------------------------------------------
 /// Helper struct for partitioning the tuples
@@ -71,12 +119,13 @@ struct SplitHelper {
 //---------------------------------------------------------------------------
 /// Helper struct for the software-managed buffers
 static constexpr size_t CACHE_LINE_BYTES            = 64;
-static constexpr size_t SOFTWARE_BUFFER_SIZE        = CACHE_LINE_BYTES / sizeof(tuple_t); // number of tuples per cache line TODO: is key or tuple
-static constexpr size_t SOFTWARE_BUFFER_MASK        = SOFTWARE_BUFFER_SIZE - 1;
+static constexpr size_t SOFTWARE_BUFFER_BUDGET      = 512 << 10; // buffers of all partitions of a pass, they stay in the L2 cache
+static constexpr size_t SOFTWARE_BUFFER_MAX_LINES   = 16;        // cache lines buffered per partition for small fan-outs
+static constexpr size_t SOFTWARE_BUFFER_MAX_FANOUT  = 1 << 12;   // larger fan-outs are split in two passes, the second one in place
+static constexpr size_t HUGE_PAGE_BYTES             = 2 << 20;
 
 union CacheLineBuffer {
    char raw[64];
-   tuple_t tuples[SOFTWARE_BUFFER_SIZE];
    uint64_t bits[8] = {0, 0, 0, 0, 0, 0, 0, 0};
 };
 //---------------------------------------------------------------------------
@@ -109,28 +158,17 @@ storeNontemp(uint8_t *dst, uint8_t *src, unsigned cnt = 1) {
    }
 }
 //---------------------------------------------------------------------------
-/**
-  * @brief Class to time executions.
-  */
-class Timer {
-public:
-  std::chrono::time_point<std::chrono::high_resolution_clock> start;
-
-  /**
-    * @brief Take timestamp at a position in the code
-    */
-  Timer() {
-    start = std::chrono::high_resolution_clock::now();
-  }
-
-  /**
-    * @brief Get milliseconds from timestamp to now
-    */
-  double get() {
-    auto end = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double> diff = end - start;
-    return diff.count() * 1000;
-  }
-};
+/// Back the huge pages within [data, data + bytes) with transparent huge pages before they are touched, a large
+/// fan-out then scatters to fewer TLB entries
+static inline void adviseHugePages(const void *data, size_t bytes) {
+   const uintptr_t begin = (reinterpret_cast<uintptr_t>(data) + HUGE_PAGE_BYTES - 1) & ~(HUGE_PAGE_BYTES - 1);
+   const uintptr_t end = (reinterpret_cast<uintptr_t>(data) + bytes) & ~(HUGE_PAGE_BYTES - 1);
+   if (begin < end) {
+      madvise(reinterpret_cast<void *>(begin), end - begin, MADV_HUGEPAGE);
+   }
+}
+//---------------------------------------------------------------------------
+/// Class to time executions, get() returns milliseconds measured with the TSC
+using Timer = CycleTimer;
 //---------------------------------------------------------------------------
 #endif  // HW3_RELATION_HPP
@@ -0,0 +1,369 @@
+#ifndef HW3_SIMDSORT_HPP
+#define HW3_SIMDSORT_HPP
+//---------------------------------------------------------------------------
+#include <immintrin.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <vector>
+//---------------------------------------------------------------------------
+/// Sorting of <key, row id> columns for the sort-merge join
+///
+/// Keys and row ids are two arrays, a SIMD register holds 8 keys and another one their 8 row ids, every comparison
+/// of keys moves the row ids with the same mask. Blocks of SORT_BLOCK pairs are sorted in registers by a sorting
+/// network and bitonic merges, blocks are merged pairwise with a bitonic merge kernel until the runs have
+/// SORT_RUN_ELEMENTS pairs, i.e., until they no longer fit in the L2 cache, and all runs are merged at once by a
+/// multiway merge.
+///
+/// Pairs sorted in registers at once
+static constexpr size_t SORT_BLOCK = 64;
+/// Pairs of a run sorted in cache, 2 * 8 bytes per pair and the same again for the merge target: 1 MiB
+static constexpr size_t SORT_RUN_ELEMENTS = 1 << 15;
+/// Row id of the pairs that fill the last block
+static constexpr uint64_t SORT_PADDING = std::numeric_limits<uint64_t>::max();
+//---------------------------------------------------------------------------
+#ifdef __AVX512F__
+// Permutes, unpacks and shuffles use the zero-masked forms on all lanes, for the reason given at simd_gather in
+// HashFunctions.hpp
+/// Keys of a become the minima, keys of b the maxima of each lane, the row ids follow their keys
+static inline void compare_exchange(__m512i &a_keys, __m512i &a_rowids, __m512i &b_keys, __m512i &b_rowids) {
+  const __mmask8 swap = _mm512_cmpgt_epu64_mask(a_keys, b_keys);
+  const __m512i min_keys = _mm512_mask_blend_epi64(swap, a_keys, b_keys);
+  const __m512i min_rowids = _mm512_mask_blend_epi64(swap, a_rowids, b_rowids);
+  b_keys = _mm512_mask_blend_epi64(swap, b_keys, a_keys);
+  b_rowids = _mm512_mask_blend_epi64(swap, b_rowids, a_rowids);
+  a_keys = min_keys;
+  a_rowids = min_rowids;
+}
+
+/// Compare-exchange of the lanes i and i ^ distance of one register, the lower lane keeps the minimum
+template <int distance>
+static inline void compare_exchange_lanes(__m512i &keys, __m512i &rowids) {
+  constexpr __mmask8 upper = distance == 4 ? 0xF0 : distance == 2 ? 0xCC : 0xAA;
+  const __m512i partner = _mm512_set_epi64(7 ^ distance, 6 ^ distance, 5 ^ distance, 4 ^ distance,
+                                           3 ^ distance, 2 ^ distance, 1 ^ distance, 0 ^ distance);
+  const __m512i partner_keys = _mm512_maskz_permutexvar_epi64(0xFF, partner, keys);
+  const __m512i partner_rowids = _mm512_maskz_permutexvar_epi64(0xFF, partner, rowids);
+  // equal keys stay, so both lanes of a pair agree on whether they swap
+  const __mmask8 take = (_mm512_cmpgt_epu64_mask(keys, partner_keys) & ~upper) | (_mm512_cmplt_epu64_mask(keys, partner_keys) & upper);
+  keys = _mm512_mask_blend_epi64(take, keys, partner_keys);
+  rowids = _mm512_mask_blend_epi64(take, rowids, partner_rowids);
+}
+
+/// Sort a bitonic register
+static inline void bitonic_clean(__m512i &keys, __m512i &rowids) {
+  compare_exchange_lanes<4>(keys, rowids);
+  compare_exchange_lanes<2>(keys, rowids);
+  compare_exchange_lanes<1>(keys, rowids);
+}
+
+static inline __m512i reverse(__m512i v) {
+  return _mm512_maskz_permutexvar_epi64(0xFF, _mm512_set_epi64(0, 1, 2, 3, 4, 5, 6, 7), v);
+}
+
+/// Sort the bitonic sequence of count registers, count is a power of two
+static inline void bitonic_merge(__m512i *keys, __m512i *rowids, size_t count) {
+  for (size_t distance = count / 2; distance > 0; distance /= 2) {
+    for (size_t i = 0; i < count; i++) {
+      if ((i & distance) == 0) compare_exchange(keys[i], rowids[i], keys[i + distance], rowids[i + distance]);
+    }
+  }
+  for (size_t i = 0; i < count; i++) bitonic_clean(keys[i], rowids[i]);
+}
+
+/// Merge the sorted runs of count registers at v and v + count into one sorted run: the second run is reversed,
+/// which makes both runs one bitonic sequence
+static inline void merge_registers(__m512i *keys, __m512i *rowids, size_t count) {
+  for (size_t i = 0; i < count / 2; i++) {
+    std::swap(keys[count + i], keys[2 * count - 1 - i]);
+    std::swap(rowids[count + i], rowids[2 * count - 1 - i]);
+  }
+  for (size_t i = count; i < 2 * count; i++) {
+    keys[i] = reverse(keys[i]);
+    rowids[i] = reverse(rowids[i]);
+  }
+  bitonic_merge(keys, rowids, 2 * count);
+}
+
+/// Transpose the 8 x 8 matrix of 64-bit lanes
+static inline void transpose(__m512i *v) {
+  __m512i s[8], u[8];
+  for (int i = 0; i < 8; i += 2) {
+    s[i] = _mm512_maskz_unpacklo_epi64(0xFF, v[i], v[i + 1]);      // columns 0, 2, 4, 6 of rows i, i + 1
+    s[i + 1] = _mm512_maskz_unpackhi_epi64(0xFF, v[i], v[i + 1]);  // columns 1, 3, 5, 7
+  }
+  const __m512i low_pairs = _mm512_set_epi64(13, 12, 5, 4, 9, 8, 1, 0);
+  const __m512i high_pairs = _mm512_set_epi64(15, 14, 7, 6, 11, 10, 3, 2);
+  for (int i = 0; i < 8; i += 4) {
+    u[i] = _mm512_permutex2var_epi64(s[i], low_pairs, s[i + 2]);       // columns 0, 4 of rows i..i + 3
+    u[i + 1] = _mm512_permutex2var_epi64(s[i + 1], low_pairs, s[i + 3]);  // columns 1, 5
+    u[i + 2] = _mm512_permutex2var_epi64(s[i], high_pairs, s[i + 2]);  // columns 2, 6
+    u[i + 3] = _mm512_permutex2var_epi64(s[i + 1], high_pairs, s[i + 3]);  // columns 3, 7
+  }
+  for (int i = 0; i < 4; i++) {
+    v[i] = _mm512_maskz_shuffle_i64x2(0xFF, u[i], u[i + 4], 0x44);
+    v[i + 4] = _mm512_maskz_shuffle_i64x2(0xFF, u[i], u[i + 4], 0xEE);
+  }
+}
+
+/// Sort SORT_BLOCK pairs in registers
+/// The optimal 19 comparator network on 8 registers sorts the 8 columns, the transposed columns are 8 sorted
+/// registers, and three levels of bitonic merges sort all 64 pairs.
+static inline void sort_block(uint64_t *keys, uint64_t *rowids) {
+  static constexpr int network[19][2] = {{0, 2}, {1, 3}, {4, 6}, {5, 7}, {0, 4}, {1, 5}, {2, 6}, {3, 7}, {0, 1}, {2, 3},
+                                         {4, 5}, {6, 7}, {2, 4}, {3, 5}, {1, 4}, {3, 6}, {1, 2}, {3, 4}, {5, 6}};
+  __m512i k[8], v[8];
+  for (int i = 0; i < 8; i++) {
+    k[i] = _mm512_loadu_si512(keys + 8 * i);
+    v[i] = _mm512_loadu_si512(rowids + 8 * i);
+  }
+  for (const auto &comparator : network) {
+    compare_exchange(k[comparator[0]], v[comparator[0]], k[comparator[1]], v[comparator[1]]);
+  }
+  transpose(k);
+  transpose(v);
+  for (size_t count = 1; count < 8; count *= 2) {
+    for (size_t i = 0; i < 8; i += 2 * count) merge_registers(k + i, v + i, count);
+  }
+  for (int i = 0; i < 8; i++) {
+    _mm512_storeu_si512(keys + 8 * i, k[i]);
+    _mm512_storeu_si512(rowids + 8 * i, v[i]);
+  }
+}
+
+/// Merge the sorted runs a and b, their lengths are multiples of 8
+/// The kernel keeps the 8 largest pairs merged so far in a register, merges them with the next 8 pairs of the run with
+/// the smaller head, and writes the 8 smaller ones.
+static inline void merge_runs(const uint64_t *a_keys, const uint64_t *a_rowids, size_t a_size, const uint64_t *b_keys,
+                              const uint64_t *b_rowids, size_t b_size, uint64_t *out_keys, uint64_t *out_rowids) {
+  assert(a_size % 8 == 0 && b_size % 8 == 0 && a_size > 0 && b_size > 0);
+  __m512i k[2] = {_mm512_loadu_si512(a_keys), _mm512_loadu_si512(b_keys)};
+  __m512i v[2] = {_mm512_loadu_si512(a_rowids), _mm512_loadu_si512(b_rowids)};
+  size_t a = 8, b = 8;
+  for (;;) {
+    merge_registers(k, v, 1);
+    _mm512_storeu_si512(out_keys, k[0]);
+    _mm512_storeu_si512(out_rowids, v[0]);
+    out_keys += 8;
+    out_rowids += 8;
+    if (a == a_size && b == b_size) break;
+    k[0] = k[1];
+    v[0] = v[1];
+    if (b == b_size || (a < a_size && a_keys[a] <= b_keys[b])) {
+      k[1] = _mm512_loadu_si512(a_keys + a);
+      v[1] = _mm512_loadu_si512(a_rowids + a);
+      a += 8;
+    } else {
+      k[1] = _mm512_loadu_si512(b_keys + b);
+      v[1] = _mm512_loadu_si512(b_rowids + b);
+      b += 8;
+    }
+  }
+  _mm512_storeu_si512(out_keys, k[1]);
+  _mm512_storeu_si512(out_rowids, v[1]);
+}
+/// Merge the 8 sorted pairs in carry with the next 8 sorted pairs, writes the smaller 8 to out and keeps the larger 8
+/// in carry
+static inline void merge_block(uint64_t *carry_keys, uint64_t *carry_rowids, const uint64_t *next_keys, const uint64_t *next_rowids,
+                               uint64_t *out_keys, uint64_t *out_rowids) {
+  __m512i k[2] = {_mm512_loadu_si512(carry_keys), _mm512_loadu_si512(next_keys)};
+  __m512i v[2] = {_mm512_loadu_si512(carry_rowids), _mm512_loadu_si512(next_rowids)};
+  merge_registers(k, v, 1);
+  _mm512_storeu_si512(out_keys, k[0]);
+  _mm512_storeu_si512(out_rowids, v[0]);
+  _mm512_storeu_si512(carry_keys, k[1]);
+  _mm512_storeu_si512(carry_rowids, v[1]);
+}
+#else
+/// Sort SORT_BLOCK pairs, insertion sort without AVX-512
+static inline void sort_block(uint64_t *keys, uint64_t *rowids) {
+  for (size_t i = 1; i < SORT_BLOCK; i++) {
+    const uint64_t key = keys[i], rowid = rowids[i];
+    size_t j = i;
+    for (; j > 0 && keys[j - 1] > key; j--) {
+      keys[j] = keys[j - 1];
+      rowids[j] = rowids[j - 1];
+    }
+    keys[j] = key;
+    rowids[j] = rowid;
+  }
+}
+
+/// Merge the sorted runs a and b
+static inline void merge_runs(const uint64_t *a_keys, const uint64_t *a_rowids, size_t a_size, const uint64_t *b_keys,
+                              const uint64_t *b_rowids, size_t b_size, uint64_t *out_keys, uint64_t *out_rowids) {
+  size_t a = 0, b = 0;
+  while (a < a_size || b < b_size) {
+    const bool take_a = b == b_size || (a < a_size && a_keys[a] <= b_keys[b]);
+    *out_keys++ = take_a ? a_keys[a] : b_keys[b];
+    *out_rowids++ = take_a ? a_rowids[a++] : b_rowids[b++];
+  }
+}
+
+/// Merge the 8 sorted pairs in carry with the next 8 sorted pairs, writes the smaller 8 to out and keeps the larger 8
+/// in carry
+static inline void merge_block(uint64_t *carry_keys, uint64_t *carry_rowids, const uint64_t *next_keys, const uint64_t *next_rowids,
+                               uint64_t *out_keys, uint64_t *out_rowids) {
+  uint64_t keys[16], rowids[16];
+  merge_runs(carry_keys, carry_rowids, 8, next_keys, next_rowids, 8, keys, rowids);
+  std::copy(keys, keys + 8, out_keys);
+  std::copy(rowids, rowids + 8, out_rowids);
+  std::copy(keys + 8, keys + 16, carry_keys);
+  std::copy(rowids + 8, rowids + 16, carry_rowids);
+}
+#endif
+//---------------------------------------------------------------------------
+/// Multiway merge of sorted runs in one pass over the memory
+///
+/// A binary tree of merges, the leaves are the runs. Every inner node merges its two children with merge_block() into
+/// a small buffer, and refills the buffer of a child once it consumed it. The buffers of all nodes fit in the L2
+/// cache, so only the runs and the output of the root are read from and written to memory.
+class MultiwayMerge {
+public:
+  /// Buffers of all inner nodes
+  static constexpr size_t BUFFER_BUDGET = 512 << 10;
+
+  /// Merge the runs [run_starts[i], run_starts[i + 1]) of keys and row ids to out, their lengths are multiples of 8
+  MultiwayMerge(const uint64_t *keys, const uint64_t *rowids, const std::vector<size_t> &run_starts, uint64_t *out_keys, uint64_t *out_rowids) {
+    const size_t runs = run_starts.size() - 1;
+    size_t leaves = 1;
+    while (leaves < runs) leaves *= 2;
+    const size_t capacity = std::clamp<size_t>(BUFFER_BUDGET / (leaves * 2 * sizeof(uint64_t)) / 8 * 8, 64, 1024);
+    // nodes_[1] is the root, nodes_[leaves + i] the run i, missing runs are empty
+    nodes_.resize(2 * leaves);
+    buffers_.resize(2 * leaves * capacity);
+    for (size_t i = 0; i < leaves; i++) {
+      Node &leaf = nodes_[leaves + i];
+      leaf.keys = const_cast<uint64_t *>(keys) + (i < runs ? run_starts[i] : 0);
+      leaf.rowids = const_cast<uint64_t *>(rowids) + (i < runs ? run_starts[i] : 0);
+      leaf.end = i < runs ? run_starts[i + 1] - run_starts[i] : 0;
+      leaf.finished = true;
+    }
+    for (size_t node = 2; node < leaves; node++) {
+      nodes_[node].keys = &buffers_[2 * node * capacity];
+      nodes_[node].rowids = &buffers_[(2 * node + 1) * capacity];
+      nodes_[node].capacity = capacity;
+    }
+    nodes_[1].keys = out_keys;
+    nodes_[1].rowids = out_rowids;
+    nodes_[1].capacity = run_starts.back() - run_starts.front();
+    if (leaves == 1) {
+      std::copy(keys, keys + nodes_[1].capacity, out_keys);
+      std::copy(rowids, rowids + nodes_[1].capacity, out_rowids);
+      return;
+    }
+    fill(1);
+    assert(nodes_[1].end == nodes_[1].capacity);
+  }
+
+private:
+  struct Node {
+    /// Buffer of an inner node, run of a leaf, the pairs [begin, end) are not consumed yet
+    uint64_t *keys = nullptr;
+    uint64_t *rowids = nullptr;
+    size_t begin = 0;
+    size_t end = 0;
+    size_t capacity = 0;
+    /// No pairs follow [begin, end)
+    bool finished = false;
+    /// The 8 largest pairs merged so far
+    bool carries = false;
+    alignas(64) uint64_t carry_keys[8];
+    alignas(64) uint64_t carry_rowids[8];
+  };
+
+  /// Merge the children of node into its empty buffer until it is full or the children are consumed
+  void fill(size_t node) {
+    Node &n = nodes_[node];
+    Node &left = nodes_[2 * node];
+    Node &right = nodes_[2 * node + 1];
+    n.begin = 0;
+    n.end = 0;
+    while (n.end + 8 <= n.capacity) {
+      if (left.begin == left.end && !left.finished) fill(2 * node);
+      if (right.begin == right.end && !right.finished) fill(2 * node + 1);
+      const bool left_empty = left.begin == left.end, right_empty = right.begin == right.end;
+      if (left_empty && right_empty) {
+        if (n.carries) {
+          std::copy(n.carry_keys, n.carry_keys + 8, n.keys + n.end);
+          std::copy(n.carry_rowids, n.carry_rowids + 8, n.rowids + n.end);
+          n.end += 8;
+          n.carries = false;
+        }
+        n.finished = true;
+        return;
+      }
+      // next 8 pairs from the child with the smaller head
+      Node &child = right_empty || (!left_empty && left.keys[left.begin] <= right.keys[right.begin]) ? left : right;
+      if (n.carries) {
+        merge_block(n.carry_keys, n.carry_rowids, child.keys + child.begin, child.rowids + child.begin, n.keys + n.end, n.rowids + n.end);
+        n.end += 8;
+      } else {
+        std::copy(child.keys + child.begin, child.keys + child.begin + 8, n.carry_keys);
+        std::copy(child.rowids + child.begin, child.rowids + child.begin + 8, n.carry_rowids);
+        n.carries = true;
+      }
+      child.begin += 8;
+    }
+  }
+
+  std::vector<Node> nodes_;
+  std::vector<uint64_t> buffers_;
+};
+//---------------------------------------------------------------------------
+/// Sort the pairs of keys and rowids by key, not stable
+/// Both arrays are padded to whole blocks with the maximum key and SORT_PADDING as row id, the padding is removed
+/// again. Row ids must be below SORT_PADDING.
+inline void sort_key_rowids(std::vector<uint64_t> &keys, std::vector<uint64_t> &rowids) {
+  assert(keys.size() == rowids.size());
+  // the sorting network does not profit from sorted input, e.g., of a clustered table, one scan does
+  if (std::is_sorted(keys.begin(), keys.end())) return;
+  const size_t size = keys.size();
+  const size_t padded = (size + SORT_BLOCK - 1) / SORT_BLOCK * SORT_BLOCK;
+  keys.resize(padded, std::numeric_limits<uint64_t>::max());
+  rowids.resize(padded, SORT_PADDING);
+
+  // Step 1: sort blocks in registers
+  for (size_t block = 0; block < padded; block += SORT_BLOCK) {
+    sort_block(&keys[block], &rowids[block]);
+  }
+
+  // Step 2: merge pairs of runs until the runs leave the cache
+  std::vector<uint64_t> tmp_keys(padded), tmp_rowids(padded);
+  size_t run = SORT_BLOCK;
+  for (; run < SORT_RUN_ELEMENTS && run < padded; run *= 2) {
+    for (size_t start = 0; start < padded; start += 2 * run) {
+      const size_t middle = std::min(start + run, padded), end = std::min(start + 2 * run, padded);
+      if (middle == end) {
+        std::copy(&keys[start], &keys[0] + end, &tmp_keys[start]);
+        std::copy(&rowids[start], &rowids[0] + end, &tmp_rowids[start]);
+      } else {
+        merge_runs(&keys[start], &rowids[start], middle - start, &keys[middle], &rowids[middle], end - middle, &tmp_keys[start], &tmp_rowids[start]);
+      }
+    }
+    keys.swap(tmp_keys);
+    rowids.swap(tmp_rowids);
+  }
+
+  // Step 3: merge all runs at once
+  if (run < padded) {
+    std::vector<size_t> run_starts;
+    for (size_t start = 0; start < padded; start += run) run_starts.push_back(start);
+    run_starts.push_back(padded);
+    MultiwayMerge(keys.data(), rowids.data(), run_starts, tmp_keys.data(), tmp_rowids.data());
+    keys.swap(tmp_keys);
+    rowids.swap(tmp_rowids);
+  }
+
+  // Step 4: remove the padding, it is among the pairs with the maximum key at the end
+  size_t last = padded;
+  while (last > 0 && keys[last - 1] == std::numeric_limits<uint64_t>::max()) last--;
+  const size_t kept = std::remove(rowids.begin() + last, rowids.end(), SORT_PADDING) - rowids.begin();
+  assert(kept == size);
+  keys.resize(kept);
+  rowids.resize(kept);
+}
+//---------------------------------------------------------------------------
+#endif  // HW3_SIMDSORT_HPP
@@ -41,6 +41,9 @@ protected:
       s_key.emplace_back(it);
     }
 
+    for (size_t i = 0; i < r.size(); i++) r[i].value[ROWID_VALUE] = i;
+    for (size_t i = 0; i < s.size(); i++) s[i].value[ROWID_VALUE] = i;
+
     std::sort(r_key.begin(), r_key.end());
     std::sort(s_key.begin(), s_key.end());
 
@@ -56,6 +59,18 @@ protected:
 
 };
 //---------------------------------------------------------------------------
+/// Sets a global join option and restores it when the scope ends, also when an assertion fails
+template <typename T>
+struct OptionGuard {
+  OptionGuard(T &option, T value) : option(option), previous(std::exchange(option, value)) {}
+  ~OptionGuard() { option = previous; }
+  OptionGuard(const OptionGuard &) = delete;
+  OptionGuard &operator=(const OptionGuard &) = delete;
+
+  T &option;
+  const T previous;
+};
+//---------------------------------------------------------------------------
 TEST_F(HashJoinTest, TrivialHashJoin) {
   ASSERT_EQ(num_match, hash_join(r, s));
   std::cout << "TrivialHashJoin: num_match == " << num_match << std::endl;
@@ -106,4 +121,334 @@ TEST_F(HashJoinTest, PartitionMultiPassHashJoinSoftwareBuffer) {
     }
   }
 }
-//---------------------------------------------------------------------------
\ No newline at end of file
+//---------------------------------------------------------------------------
+TEST(JoinHashTableTest, DuplicateKeysAndReuse) {
+  relation r;
+  for (keyType key = 0; key < 1000; key++) {
+    r.emplace_back(key << 10);  // the low bits of all keys are equal, as within a radix partition
+    r.emplace_back(key << 10);
+  }
+  JoinHashTable<> hash_table;
+  for (size_t round = 0; round < 2; round++) {
+    hash_table.reset(r.size() >> round);
+    for (size_t i = 0; i < r.size() >> round; i++) {
+      hash_table.insert(r[i].key, &r[i]);
+    }
+    ASSERT_EQ(2u, hash_table.count(0));
+    ASSERT_EQ(round == 0 ? 2u : 0u, hash_table.count(999 << 10));
+    ASSERT_EQ(0u, hash_table.count(1));
+    hash_table.probe(5 << 10, [](const tuple_t *tuple) { ASSERT_EQ(keyType{5 << 10}, tuple->key); });
+    // Group prefetching finds the same matches, batches that are not a multiple of the group
+    std::vector<size_t> matches(r.size(), 0);
+    hash_table.probeBatch(r.data(), r.size() - 1, [&](size_t i, const tuple_t *tuple) {
+      ASSERT_EQ(r[i].key, tuple->key);
+      matches[i]++;
+    });
+    for (size_t i = 0; i < r.size() - 1; i++) {
+      ASSERT_EQ(hash_table.count(r[i].key), matches[i]);
+    }
+  }
+}
+//---------------------------------------------------------------------------
+TEST_F(HashJoinTest, HashPolicies) {
+  // Every policy must join correctly, on strided keys only the identity leaves partitions empty
+  for (auto &tuple : r) tuple.key <<= 8;
+  for (auto &tuple : s) tuple.key <<= 8;
+  for (const char *name : {"identity", "fibonacci", "murmur", "crc32", "simd-murmur"}) {
+    HashPolicy policy = HashPolicy::IDENTITY;
+    ASSERT_TRUE(parse_hash_policy(name, policy));
+    for (bool software_managed_buffer : {false, true}) {
+      relation r_copy(r); relation s_copy(s);
+      ASSERT_EQ(num_match, partition_naive_radix_hash_join(r_copy, s_copy, 10, partition_function_for(policy, software_managed_buffer)));
+      ASSERT_EQ(policy == HashPolicy::IDENTITY, r_balance.empty > 0) << name;
+      r_copy = r; s_copy = s;
+      ASSERT_EQ(num_match, partition_multiPass_radix_hash_join(r_copy, s_copy, 5, 5, partition_function_for(policy, software_managed_buffer)));
+    }
+    // The table spreads the keys of a partition over all of its slots, whatever bits the policy partitions on
+    partition p_in(r), p_out;
+    p_in.start_points = {0, r.size()};
+    p_out.relation_.reserve(r.size());
+    partition_function_for(policy, false)(p_in, SplitHelper(10), p_out);
+    JoinHashTable<> hash_table;
+    size_t longest = 0;
+    for (size_t i = 0; i + 1 < p_out.start_points.size(); i++) {
+      hash_table.reset(p_out.start_points[i + 1] - p_out.start_points[i]);
+      for (size_t j = p_out.start_points[i]; j < p_out.start_points[i + 1]; j++) hash_table.insert(p_out.relation_[j].key, &p_out.relation_[j]);
+      longest = std::max(longest, hash_table.longestRun());
+    }
+    std::cout << "HashPolicies: " << name << " longest run " << longest << std::endl;
+    ASSERT_LT(longest, 128u) << name;
+  }
+  HashPolicy policy = HashPolicy::IDENTITY;
+  ASSERT_FALSE(parse_hash_policy("sha256", policy));
+}
+//---------------------------------------------------------------------------
+TEST_F(HashJoinTest, PartitionSkewHashJoin) {
+  // Unique keys, no heavy hitters. Few bits leave partitions above SKEW_PARTITION_LIMIT that are split.
+  for (uint64_t bits : {1, 4, 8, 12, 19}) {
+    ASSERT_EQ(num_match, partition_skew_radix_hash_join(r, s, bits, partition_impl));
+    std::cout << "PartitionSkewHashJoin: bits " << bits <<  " | " << "num_match == " << num_match << std::endl;
+  }
+}
+//---------------------------------------------------------------------------
+TEST(SkewJoinTest, ZipfFactors) {
+  // Heavy hitters, split partitions and partitions that no split helps (identity hash of strided keys)
+  static constexpr size_t RELATION_SIZE = 1 << 18;
+  std::mt19937 gen(42);
+  for (double theta : {0.0, 0.5, 1.0, 1.25, 1.5}) {
+    ZipfGenerator zipf(RELATION_SIZE, theta);
+    relation r, s;
+    for (size_t i = 0; i < RELATION_SIZE; i++) r.emplace_back(zipf(gen));
+    for (size_t i = 0; i < RELATION_SIZE; i++) s.emplace_back(zipf(gen));
+    const uint64_t expected = sort_merge_count(r.data(), r.data() + r.size(), s.data(), s.data() + s.size());
+    for (uint64_t bits : {2, 8}) {
+      Timer t = Timer();
+      ASSERT_EQ(expected, partition_skew_radix_hash_join(r, s, bits, partition_function_for(HashPolicy::MURMUR, false)));
+      std::cout << "PartitionSkewHashJoin: zipf " << std::setprecision(2) << theta << " | bits " << bits << " | " << t.get() << " ms" << std::endl;
+      if (theta >= 1.0) {
+        ASSERT_GT(skew_stats.heavy_hitters, 0u);
+      }
+    }
+    for (auto &tuple : r) tuple.key <<= 32;
+    for (auto &tuple : s) tuple.key <<= 32;
+    ASSERT_EQ(expected, partition_skew_radix_hash_join(r, s, 2, partition_impl));
+    ASSERT_GT(skew_stats.sorted_partitions, 0u);
+  }
+}
+//---------------------------------------------------------------------------
+TEST_F(HashJoinTest, MaterializedOutput) {
+  // Every join emits each match once, with the payloads and row ids of the matching tuples
+  for (int join = 0; join < 4; join++) {
+    JoinOutput<PayloadResult> payloads;
+    JoinOutput<RowIdResult> rowids;
+    relation r_copy(r); relation s_copy(s);
+    switch (join) {
+      case 0: ASSERT_EQ(num_match, hash_join(r, s, payloads)); ASSERT_EQ(num_match, hash_join(r, s, rowids)); break;
+      case 1:
+        ASSERT_EQ(num_match, partition_naive_radix_hash_join(r, s, 8, partition_impl, payloads));
+        ASSERT_EQ(num_match, partition_naive_radix_hash_join(r, s, 8, partition_software_managed_buffer_impl, rowids));
+        break;
+      case 2:
+        ASSERT_EQ(num_match, partition_multiPass_radix_hash_join(r_copy, s_copy, 4, 4, partition_software_managed_buffer_impl, payloads));
+        r_copy = r; s_copy = s;  // the multi-pass join moves its input
+        ASSERT_EQ(num_match, partition_multiPass_radix_hash_join(r_copy, s_copy, 4, 4, partition_impl, rowids));
+        break;
+      case 3:
+        ASSERT_EQ(num_match, partition_skew_radix_hash_join(r, s, 2, partition_impl, payloads));
+        ASSERT_EQ(num_match, partition_skew_radix_hash_join(r, s, 2, partition_impl, rowids));
+        break;
+    }
+    payloads.flush();
+    rowids.flush();
+    ASSERT_EQ(num_match, payloads.size());
+    ASSERT_EQ(num_match, rowids.size());
+    std::vector<bool> seen(s.size(), false);
+    for (size_t i = 0; i < num_match; i++) {
+      const PayloadResult &result = payloads[i];
+      ASSERT_EQ(result.key, r[result.r_value[ROWID_VALUE]].key);
+      ASSERT_EQ(result.key, s[result.s_value[ROWID_VALUE]].key);
+      ASSERT_EQ(r[rowids[i].r_rowid].key, s[rowids[i].s_rowid].key);
+      ASSERT_FALSE(seen[rowids[i].s_rowid]);  // unique keys, one match per s tuple
+      seen[rowids[i].s_rowid] = true;
+    }
+  }
+}
+//---------------------------------------------------------------------------
+TEST(JoinOutputTest, ChunksAndDuplicates) {
+  // More results than one chunk, each r tuple matches 3 s tuples, and a heavy hitter joined by the nested loop
+  relation r, s;
+  for (keyType key = 0; key < 20000; key++) {
+    r.emplace_back(key);
+    r.back().value[ROWID_VALUE] = r.size() - 1;
+    for (int i = 0; i < 3; i++) {
+      s.emplace_back(key);
+      s.back().value[ROWID_VALUE] = s.size() - 1;
+    }
+  }
+  const keyType heavy_key = keyType{1} << 40;
+  for (int i = 0; i < 2000; i++) {
+    r.emplace_back(heavy_key);
+    r.back().value[ROWID_VALUE] = r.size() - 1;
+  }
+  for (int i = 0; i < 2; i++) {
+    s.emplace_back(heavy_key);
+    s.back().value[ROWID_VALUE] = s.size() - 1;
+  }
+  JoinOutput<PayloadResult> output;
+  ASSERT_EQ(60000u + 2 * 2000, partition_skew_radix_hash_join(r, s, 4, partition_impl, output));
+  ASSERT_EQ(1u, skew_stats.heavy_hitters);
+  output.flush();
+  ASSERT_EQ(60000u + 2 * 2000, output.size());
+  ASSERT_GT(output.size(), JoinOutput<PayloadResult>::CHUNK_RESULTS);
+  for (size_t i = 0; i < output.size(); i++) {
+    ASSERT_EQ(output[i].key, s[output[i].s_value[ROWID_VALUE]].key);
+    ASSERT_EQ(output[i].key, r[output[i].r_value[ROWID_VALUE]].key);
+  }
+  output.clear();
+  ASSERT_EQ(0u, output.size());
+}
+//---------------------------------------------------------------------------
+TEST_F(HashJoinTest, PartitionCompactHashJoin) {
+  // Partitioning <key, row id> pairs of 8 + 8 and 4 + 4 bytes, also with software managed buffers of several cache lines,
+  // the payloads are fetched by row id
+  ASSERT_TRUE(fits_compact_layout<key_rowid32_t>(r, s));
+  for (uint64_t bits : {1, 8, 19}) {
+    ASSERT_EQ(num_match, partition_compact_radix_hash_join<key_rowid64_t>(r, s, bits, partition_impl));
+    ASSERT_EQ(num_match, partition_compact_radix_hash_join<key_rowid32_t>(r, s, bits, partition_function_for<key_rowid32_t>(HashPolicy::SIMD_MURMUR, false)));
+    ASSERT_EQ(num_match, partition_compact_radix_hash_join<key_rowid64_t>(r, s, bits, partition_software_managed_buffer_impl));
+    ASSERT_EQ(num_match, partition_compact_radix_hash_join<key_rowid32_t>(r, s, bits, partition_function_for<key_rowid32_t>(HashPolicy::MURMUR, true)));
+  }
+  JoinOutput<PayloadResult> output;
+  ASSERT_EQ(num_match, partition_compact_radix_hash_join<key_rowid64_t>(r, s, 8, partition_function_for<key_rowid64_t>(HashPolicy::SIMD_MURMUR, false), output));
+  output.flush();
+  for (size_t i = 0; i < output.size(); i++) {
+    ASSERT_EQ(output[i].key, r[output[i].r_value[ROWID_VALUE]].key);
+    ASSERT_EQ(output[i].key, s[output[i].s_value[ROWID_VALUE]].key);
+  }
+  relation large{tuple_t(keyType{1} << 32)};
+  ASSERT_FALSE(fits_compact_layout<key_rowid32_t>(large, s));
+  ASSERT_TRUE(fits_compact_layout<key_rowid64_t>(large, s));
+}
+//---------------------------------------------------------------------------
+TEST_F(HashJoinTest, PartitionParallelHashJoin) {
+  // Thread counts that do not divide the relations or the partitions, more threads than partitions
+  for (size_t threads : {1, 2, 3, 8}) {
+    for (uint64_t bits : {1, 8, 16}) {
+      ASSERT_EQ(num_match, partition_parallel_naive_radix_hash_join(r, s, bits, threads));
+      ASSERT_EQ(num_match, partition_parallel_multiPass_radix_hash_join<MurmurHash>(r, s, bits, 4, threads));
+      std::cout << "PartitionParallelHashJoin: threads " << threads << " | bits " << bits << " | " << "num_match == " << num_match << std::endl;
+    }
+  }
+  // Every thread emits into its own output, together each match once
+  std::vector<JoinOutput<RowIdResult>> outputs(3);
+  ASSERT_EQ(num_match, partition_parallel_multiPass_radix_hash_join<SimdMurmurHash>(r, s, 5, 5, outputs.size(), outputs));
+  std::vector<bool> seen(s.size(), false);
+  size_t results = 0;
+  for (auto &output : outputs) {
+    output.flush();
+    results += output.size();
+    for (size_t i = 0; i < output.size(); i++) {
+      ASSERT_EQ(r[output[i].r_rowid].key, s[output[i].s_rowid].key);
+      ASSERT_FALSE(seen[output[i].s_rowid]);
+      seen[output[i].s_rowid] = true;
+    }
+  }
+  ASSERT_EQ(num_match, results);
+}
+//---------------------------------------------------------------------------
+TEST(SimdSortTest, KeysAndRowIds) {
+  // Sizes around whole blocks, more than one cache-sized run for the multiway merge, duplicates and the maximum key
+  std::mt19937 gen(42);
+  for (size_t size : {size_t{0}, size_t{1}, size_t{63}, size_t{64}, size_t{65}, size_t{1000}, 3 * SORT_RUN_ELEMENTS + 7}) {
+    for (uint64_t key_range : {uint64_t{16}, std::numeric_limits<uint64_t>::max()}) {
+      std::uniform_int_distribution<uint64_t> uni(0, key_range);
+      std::vector<uint64_t> keys(size), rowids(size);
+      for (size_t i = 0; i < size; i++) {
+        keys[i] = i % 5 == 0 ? std::numeric_limits<uint64_t>::max() : uni(gen);
+        rowids[i] = i;
+      }
+      const std::vector<uint64_t> input = keys;
+      sort_key_rowids(keys, rowids);
+      ASSERT_EQ(size, keys.size());
+      ASSERT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+      std::vector<bool> seen(size, false);
+      for (size_t i = 0; i < size; i++) {
+        ASSERT_EQ(input[rowids[i]], keys[i]);
+        ASSERT_FALSE(seen[rowids[i]]);
+        seen[rowids[i]] = true;
+      }
+    }
+  }
+}
+//---------------------------------------------------------------------------
+TEST_F(HashJoinTest, SortMergeJoin) {
+  for (size_t threads : {1, 3}) {
+    ASSERT_EQ(num_match, mpsm_sort_merge_join(r, s, threads));
+    std::cout << "SortMergeJoin: threads " << threads << " | " << "num_match == " << num_match << std::endl;
+  }
+  // Pre-sorted input
+  relation r_sorted(r), s_sorted(s);
+  std::sort(r_sorted.begin(), r_sorted.end());
+  std::sort(s_sorted.begin(), s_sorted.end());
+  ASSERT_EQ(num_match, mpsm_sort_merge_join(r_sorted, s_sorted, 2));
+  // Duplicates
+  ZipfGenerator zipf(1 << 16, 1.0);
+  std::mt19937 gen(42);
+  relation r_zipf, s_zipf;
+  for (size_t i = 0; i < (1 << 16); i++) r_zipf.emplace_back(zipf(gen));
+  for (size_t i = 0; i < (1 << 16); i++) s_zipf.emplace_back(zipf(gen));
+  ASSERT_EQ(sort_merge_count(r_zipf.data(), r_zipf.data() + r_zipf.size(), s_zipf.data(), s_zipf.data() + s_zipf.size()),
+            mpsm_sort_merge_join(r_zipf, s_zipf, 2));
+  // Every thread emits into its own output, together each match once
+  std::vector<JoinOutput<PayloadResult>> outputs(2);
+  ASSERT_EQ(num_match, mpsm_sort_merge_join(r, s, outputs.size(), outputs));
+  std::vector<bool> seen(s.size(), false);
+  size_t results = 0;
+  for (auto &output : outputs) {
+    output.flush();
+    results += output.size();
+    for (size_t i = 0; i < output.size(); i++) {
+      ASSERT_EQ(output[i].key, r[output[i].r_value[ROWID_VALUE]].key);
+      ASSERT_EQ(output[i].key, s[output[i].s_value[ROWID_VALUE]].key);
+      ASSERT_FALSE(seen[output[i].s_value[ROWID_VALUE]]);
+      seen[output[i].s_value[ROWID_VALUE]] = true;
+    }
+  }
+  ASSERT_EQ(num_match, results);
+}
+//---------------------------------------------------------------------------
+TEST_F(HashJoinTest, BloomFilterProbeSide) {
+  // No false negatives, few false positives
+  BloomFilter filter;
+  filter.reset(r.size());
+  for (const auto &tuple : r) filter.insert(tuple.key);
+  for (const auto &tuple : r) ASSERT_TRUE(filter.contains(tuple.key));
+  uint32_t selection[HASH_BATCH];
+  for (size_t begin = 0; begin + HASH_BATCH <= s.size(); begin += HASH_BATCH) {
+    const size_t selected = filter.select(s.data() + begin, HASH_BATCH, selection);
+    for (size_t i = 0, j = 0; i < HASH_BATCH; i++) {
+      const bool passed = j < selected && selection[j] == i;
+      ASSERT_EQ(filter.contains(s[begin + i].key), passed);
+      j += passed;
+    }
+  }
+
+  OptionGuard<bool> filter_probe_side(bloom_filter_probe_side, true);
+  ASSERT_EQ(num_match, hash_join(r, s));
+  ASSERT_EQ(s.size(), bloom_stats.probed);
+  ASSERT_LE(num_match, bloom_stats.passed);
+  ASSERT_LT(bloom_stats.passed, num_match + s.size() / 50);
+  {
+    OptionGuard<bool> prefetch(group_prefetch_probe, true);
+    ASSERT_EQ(num_match, hash_join(r, s));
+  }
+  for (uint64_t bits : {1, 8}) {
+    ASSERT_EQ(num_match, partition_naive_radix_hash_join(r, s, bits, partition_impl));
+    ASSERT_LT(bloom_stats.passed, num_match + s.size() / 50);
+    relation r_copy(r), s_copy(s);
+    ASSERT_EQ(num_match, partition_multiPass_radix_hash_join(r_copy, s_copy, bits, 4, partition_software_managed_buffer_impl));
+  }
+  // The row ids of the filtered probe tuples are kept
+  JoinOutput<RowIdResult> output;
+  ASSERT_EQ(num_match, partition_naive_radix_hash_join(r, s, 8, partition_impl, output));
+  output.flush();
+  for (size_t i = 0; i < output.size(); i++) {
+    ASSERT_EQ(r[output[i].r_rowid].key, s[output[i].s_rowid].key);
+  }
+  std::cout << "BloomFilterProbeSide: passed " << bloom_stats.passed << " of " << s.size() << " | num_match == " << num_match << std::endl;
+}
+//---------------------------------------------------------------------------
+TEST_F(HashJoinTest, GroupPrefetchProbe) {
+  OptionGuard<bool> prefetch(group_prefetch_probe, true);
+  ASSERT_EQ(num_match, hash_join(r, s));
+  // The matches of a prefetched group are emitted with the row ids of their probe tuples
+  JoinOutput<RowIdResult> output;
+  ASSERT_EQ(num_match, hash_join(r, s, output));
+  output.flush();
+  ASSERT_EQ(num_match, output.size());
+  for (size_t i = 0; i < output.size(); i++) {
+    ASSERT_EQ(r[output[i].r_rowid].key, s[output[i].s_rowid].key);
+  }
+  std::cout << "GroupPrefetchProbe: num_match == " << num_match << std::endl;
+}
+//---------------------------------------------------------------------------
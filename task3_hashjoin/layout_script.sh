@@ -0,0 +1,25 @@
+#!/usr/bin/env bash
+# Partitioning with and without software managed buffers across tuple widths:
+# compact <key, row id> pairs of 8 and 16 bytes, and tuples of 1, 2 and 4 cache lines
+
+rm ohj
+make
+for layout in key-rowid32 key-rowid64
+do
+    for i in {4..16..2}
+    do
+        ./ohj 1 $i --layout=$layout
+        ./ohj 3 $i --layout=$layout
+    done
+done
+
+for payload_count in 7 15 31
+do
+    g++ -O3 -march=native -Wall --std=c++17 -DPAYLOAD_COUNT=$payload_count -o ohj ohj.cpp -lrt -pthread
+    for i in {4..16..2}
+    do
+        ./ohj 1 $i
+        ./ohj 3 $i
+    done
+done
+rm ohj
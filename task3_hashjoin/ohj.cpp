@@ -3,10 +3,44 @@
 #include <time.h>
 #include <iostream>
 #include <iomanip>
+#include <map>
+#include <string>
+
+/// Print the partition sizes, a max far above the mean means a few partitions do most of the work
+void print_balance(const char *name, const PartitionBalance &balance) {
+  std::cout << std::fixed << std::setprecision(1) << name << " partitions: " << balance.partitions << " | empty: " << balance.empty
+            << " | max: " << balance.max << " | mean: " << balance.mean << " | stddev: " << balance.stddev << std::endl;
+}
 
 int main(int argc, char *argv[]) {
+    // Options are --name=value, e.g., ohj 1 6 --hash=murmur --keys=strided --balance --threads=8, the rest is positional
+    std::map<std::string, std::string> options;
+    std::vector<char *> positional;
+    for (int i = 0; i < argc; i++) {
+      const std::string arg(argv[i]);
+      if (arg.compare(0, 2, "--") == 0) {
+        const size_t eq = arg.find('=');
+        options[arg.substr(2, eq == std::string::npos ? std::string::npos : eq - 2)] = eq == std::string::npos ? "" : arg.substr(eq + 1);
+      } else {
+        positional.push_back(argv[i]);
+      }
+    }
+    argc = positional.size();
+    argv = positional.data();
     if (argc < 2) { std::cout << "Needs more than 2 program parameters."; return 1; }
 
+    // --hash=identity|fibonacci|murmur|crc32|simd-murmur, the hash of the radix partitioning
+    HashPolicy hash_policy = HashPolicy::IDENTITY;
+    if (options.count("hash") && !parse_hash_policy(options["hash"], hash_policy)) {
+      std::cout << "Unknown hash " << options["hash"] << std::endl; return 1;
+    }
+    // --keys=uniform|strided, strided keys are multiples of 256 and all share their low bits
+    uint64_t key_shift{0};
+    if (options.count("keys") && options["keys"] != "uniform") {
+      if (options["keys"] != "strided") { std::cout << "Unknown keys " << options["keys"] << std::endl; return 1; }
+      key_shift = 8;
+    }
+
     // Set Up
     relation r;
     relation s;
@@ -27,8 +61,8 @@ int main(int argc, char *argv[]) {
     r_key.reserve(RELATION_SIZE);
 
     for (const auto& it : r_set) {
-      r.emplace_back(it);
-      r_key.emplace_back(it);
+      r.emplace_back(it << key_shift);
+      r_key.emplace_back(it << key_shift);
     }
 
     std::unordered_set<keyType> s_set;
@@ -41,8 +75,21 @@ int main(int argc, char *argv[]) {
     s_key.reserve(RELATION_SIZE);
 
     for (const auto& it : s_set) {
-      s.emplace_back(it);
-      s_key.emplace_back(it);
+      s.emplace_back(it << key_shift);
+      s_key.emplace_back(it << key_shift);
+    }
+
+    // --zipf=<theta>, r and s are drawn from a Zipf distribution over RELATION_SIZE keys instead of unique keys
+    if (options.count("zipf")) {
+      ZipfGenerator zipf(RELATION_SIZE, std::stod(options["zipf"]));
+      for (auto& tuple : r) tuple.key = zipf(gen) << key_shift;
+      for (auto& tuple : s) tuple.key = zipf(gen) << key_shift;
+    }
+
+    // --sorted, r and s are sorted by key, e.g., clustered tables
+    if (options.count("sorted")) {
+      std::sort(r.begin(), r.end());
+      std::sort(s.begin(), s.end());
     }
 
     // Hash Join
@@ -54,7 +101,7 @@ int main(int argc, char *argv[]) {
       size_t num_match = 0;
       int join = strtol(argv[1], nullptr, 0);
       uint64_t first_pass_bits{0};
-      if (argc == 3 && (join == 1 || join == 3)) {
+      if (argc == 3 && (join == 1 || join == 3 || join == 5)) {
         first_pass_bits = strtol(argv[2], nullptr, 0);
       }
       uint64_t second_pass_bits{0};
@@ -62,34 +109,86 @@ int main(int argc, char *argv[]) {
         first_pass_bits = strtol(argv[2], nullptr, 0);
         second_pass_bits = strtol(argv[3], nullptr, 0);
       }
-      Timer t = Timer();
+      Partition_Function *partition_function = partition_function_for(hash_policy, join == 3 || join == 4);
+      // --output=count|payload|rowid, count only or materialize the result with payloads or row ids
+      const std::string output_mode = options.count("output") ? options["output"] : "count";
+      if (output_mode != "count" && output_mode != "payload" && output_mode != "rowid") {
+        std::cout << "Unknown output " << output_mode << std::endl; return 1;
+      }
+      // --layout=row|key-rowid64|key-rowid32, joins 1 and 3 partition the tuples or compact <key, row id> pairs
+      const std::string layout = options.count("layout") ? options["layout"] : "row";
+      if (layout != "row" && layout != "key-rowid64" && layout != "key-rowid32") {
+        std::cout << "Unknown layout " << layout << std::endl; return 1;
+      }
+      if (layout != "row" && join != 1 && join != 3) { std::cout << "Layout " << layout << " needs join 1 or 3" << std::endl; return 1; }
+      if (layout == "key-rowid32" && !fits_compact_layout<key_rowid32_t>(r, s)) {
+        std::cout << "Keys do not fit layout " << layout << std::endl; return 1;
+      }
+      // --threads=<n>, joins 1 and 2 run in parallel on n threads, join 6 on 1 thread by default
+      const size_t threads = options.count("threads") ? std::stoul(options["threads"]) : 0;
+      if (threads != 0 && ((join != 1 && join != 2 && join != 6) || layout != "row")) { std::cout << "Threads need join 1, 2 or 6" << std::endl; return 1; }
+      // --bloom, joins 0 to 4 filter s with a Bloom filter of r before probing or partitioning it
+      bloom_filter_probe_side = options.count("bloom") != 0;
+      if (bloom_filter_probe_side && (join > 4 || threads != 0 || layout != "row")) { std::cout << "Bloom filter needs join 0 to 4 without threads or layout" << std::endl; return 1; }
+      // --prefetch, join 0 probes its hash table in groups of prefetched keys
+      group_prefetch_probe = options.count("prefetch") != 0;
+      if (group_prefetch_probe && join != 0) { std::cout << "Prefetch needs join 0" << std::endl; return 1; }
+      for (size_t i = 0; i < r.size(); i++) r[i].value[ROWID_VALUE] = i;
+      for (size_t i = 0; i < s.size(); i++) s[i].value[ROWID_VALUE] = i;
+      size_t output_bytes{0};
 
       // 0: Trivial Hash Join
       // 1: Partition Navie Hash Join
       // 2: Partition MultiPass Hash Join
       // 3: Partition Navie Hash Join Software Buffer
       // 4: Partition Multi Pass Hash Join Software Buffer
-      switch (join) {
-      case 0: {
-        num_match = hash_join(r, s);
-        break;
-      }
-      case 1: {
-        num_match = partition_naive_radix_hash_join(r, s, first_pass_bits, partition_impl);
-        break;
-      }
-      case 2: {
-        num_match = partition_multiPass_radix_hash_join(r, s, first_pass_bits, second_pass_bits, partition_impl);
-        break;
-      }
-      case 3: {
-        num_match = partition_naive_radix_hash_join(r, s, first_pass_bits, partition_software_managed_buffer_impl);
-        break;
-      }
-      case 4: {
-        num_match = partition_multiPass_radix_hash_join(r, s, first_pass_bits, second_pass_bits, partition_software_managed_buffer_impl);
-        break;
-      }
+      // 5: Partition Skew Resilient Hash Join
+      // 6: Sort Merge Join (MPSM)
+      // outputs[t] receives the matches of thread t, the single-threaded joins use outputs[0]
+      auto run_join = [&](auto &outputs) -> size_t {
+        auto &output = outputs[0];
+        if (join == 6) return mpsm_sort_merge_join(r, s, std::max<size_t>(threads, 1), outputs);
+        if (threads != 0) {
+          return with_hash_policy(hash_policy, [&](auto hash) -> size_t {
+            using Hash = decltype(hash);
+            if (join == 1) return partition_parallel_naive_radix_hash_join<Hash>(r, s, first_pass_bits, threads, outputs);
+            return partition_parallel_multiPass_radix_hash_join<Hash>(r, s, first_pass_bits, second_pass_bits, threads, outputs);
+          });
+        }
+        switch (join) {
+        case 0: return hash_join(r, s, output);
+        case 1:
+        case 3:
+          if (layout == "key-rowid64") {
+            return partition_compact_radix_hash_join<key_rowid64_t>(r, s, first_pass_bits, partition_function_for<key_rowid64_t>(hash_policy, join == 3), output);
+          } else if (layout == "key-rowid32") {
+            return partition_compact_radix_hash_join<key_rowid32_t>(r, s, first_pass_bits, partition_function_for<key_rowid32_t>(hash_policy, join == 3), output);
+          }
+          return partition_naive_radix_hash_join(r, s, first_pass_bits, partition_function, output);
+        case 2: return partition_multiPass_radix_hash_join(r, s, first_pass_bits, second_pass_bits, partition_function, output);
+        case 4: return partition_multiPass_radix_hash_join(r, s, first_pass_bits, second_pass_bits, partition_function, output);
+        case 5: return partition_skew_radix_hash_join(r, s, first_pass_bits, partition_function, output);
+        }
+        return 0;
+      };
+      Timer t = Timer();
+      if (output_mode == "payload") {
+        std::vector<JoinOutput<PayloadResult>> outputs(std::max<size_t>(threads, 1));
+        num_match = run_join(outputs);
+        for (auto &output : outputs) {
+          output.flush();
+          output_bytes += output.size() * sizeof(PayloadResult);
+        }
+      } else if (output_mode == "rowid") {
+        std::vector<JoinOutput<RowIdResult>> outputs(std::max<size_t>(threads, 1));
+        num_match = run_join(outputs);
+        for (auto &output : outputs) {
+          output.flush();
+          output_bytes += output.size() * sizeof(RowIdResult);
+        }
+      } else {
+        std::vector<CountOutput> outputs(std::max<size_t>(threads, 1));
+        num_match = run_join(outputs);
       }
       time = t.get();
 
@@ -100,11 +199,13 @@ int main(int argc, char *argv[]) {
         break;
       }
       case 1: {
+        if (threads != 0) std::cout << "Parallel(" << threads << " threads) ";
         std::cout << "PartitionNavieHashJoin: bits " << first_pass_bits <<  " | " << "num_match == " << num_match << " | ";
         std::cout << std::fixed << std::setprecision(1) << time << std::endl;
         break;
       }
       case 2: {
+        if (threads != 0) std::cout << "Parallel(" << threads << " threads) ";
         std::cout << "PartitionMultiPassHashJoin: first pass bits " << first_pass_bits << ", second pass bits " << second_pass_bits << " | " << "num_match == " << num_match << " | ";
         std::cout << std::fixed << std::setprecision(1) << time << std::endl;
         break;
@@ -119,8 +220,30 @@ int main(int argc, char *argv[]) {
         std::cout << std::fixed << std::setprecision(1) << time << std::endl;
         break;
       }
+      case 5: {
+        std::cout << "PartitionSkewHashJoin: bits " << first_pass_bits <<  " | " << "num_match == " << num_match << " | ";
+        std::cout << std::fixed << std::setprecision(1) << time << std::endl;
+        break;
       }
+      case 6: {
+        std::cout << "SortMergeJoin: threads " << std::max<size_t>(threads, 1) << " | " << "num_match == " << num_match << " | ";
+        std::cout << std::fixed << std::setprecision(1) << time << std::endl;
+        break;
+      }
+      }
+
+  if (bloom_filter_probe_side) {
+    std::cout << "BLOOM: " << bloom_stats.passed << " of " << bloom_stats.probed << " probe tuples passed" << std::endl;
+  }
+  if (output_bytes != 0) {
+    std::cout << std::fixed << std::setprecision(1) << "OUTPUT: " << output_mode << " | " << output_bytes / double(1 << 20) << " MiB" << std::endl;
+  }
+  if (options.count("balance") && join != 0 && join != 6) {
+    print_balance("R", r_balance);
+    print_balance("S", s_balance);
+  }
 
-  // TODO: performance break-down into partition, build, probe parts
+  // Performance break-down into partition, build, probe parts, build and probe per partition
+  join_phases.print(std::cout);
 }
 